@@ -0,0 +1,69 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "AsyncTask.hpp"
+#include "LandsatImage.hpp"
+#include "ThreadPool.hpp"
+#include "WaterCohererTypes.hpp"
+#include <memory>
+#include <string>
+
+namespace WaterCoherer {
+  // Coroutine interface to the scene stages for services with many scenes in flight. File
+  // reads and writes run on a small I/O pool and the raster kernels on the shared pool, so
+  // neither pool has threads blocked waiting for each other, and a suspended request only
+  // costs its coroutine frame.
+  //
+  //   auto scene = co_await AsyncScene::load_scene(directory);
+  //   auto clouds = co_await AsyncScene::detect_clouds(scene, cores);
+  //   auto water = co_await AsyncScene::localize_water(scene, cores, clouds);
+  //   co_await AsyncScene::write_layer(water, path);
+  class AsyncScene {
+  public:
+    using Scene = std::shared_ptr<LandsatImage>;
+
+    // Pool for blocking file access, separate from ThreadPool::instance().
+    static ThreadPool &io_pool();
+
+    // Waits, without holding a thread, for a scene slot of ResourceGovernor; the slot is held
+    // until the last reference to the scene is gone. The blue, green and near infrared bands
+    // the stages below view are read and decoded on the I/O pool; other bands are decoded by
+    // whoever views them first.
+    static AsyncTask<Scene> load_scene(std::string directory);
+
+    static AsyncTask<PixelMask> detect_clouds(Scene scene, unsigned int cores);
+
+    static AsyncTask<PixelMask> localize_water(Scene scene, unsigned int cores);
+
+    // Water cleared of the omitted pixels, e.g. the clouds of the scene.
+    static AsyncTask<PixelMask> localize_water(Scene scene, unsigned int cores,
+                                               PixelMask omitted_pixels);
+
+    // Finishes with false when the layer could not be written, see CogWriter::save.
+    static AsyncTask<bool> write_layer(TiffImage layer, std::string path);
+
+    // Writes the mask one bit per pixel.
+    static AsyncTask<bool> write_layer(PixelMask mask, std::string path);
+  };
+}
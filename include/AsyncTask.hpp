@@ -0,0 +1,322 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace WaterCoherer {
+  template<typename T>
+  class AsyncTask;
+
+  namespace detail {
+    struct AsyncTaskPromiseBase {
+      std::coroutine_handle<> continuation;
+      std::exception_ptr error;
+
+      struct FinalAwaiter {
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        // The awaiting coroutine is resumed on the thread that finished the task.
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+          auto continuation = handle.promise().continuation;
+          return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {
+        }
+      };
+
+      std::suspend_always initial_suspend() const noexcept {
+        return {};
+      }
+
+      FinalAwaiter final_suspend() const noexcept {
+        return {};
+      }
+
+      void unhandled_exception() {
+        error = std::current_exception();
+      }
+    };
+
+    template<typename T>
+    struct AsyncTaskPromise : AsyncTaskPromiseBase {
+      std::optional<T> value;
+
+      AsyncTask<T> get_return_object();
+
+      void return_value(T result) {
+        value.emplace(std::move(result));
+      }
+
+      T result() {
+        if (error) {
+          std::rethrow_exception(error);
+        }
+        return std::move(*value);
+      }
+    };
+
+    template<>
+    struct AsyncTaskPromise<void> : AsyncTaskPromiseBase {
+      AsyncTask<void> get_return_object();
+
+      void return_void() const {
+      }
+
+      void result() const {
+        if (error) {
+          std::rethrow_exception(error);
+        }
+      }
+    };
+
+    // Coroutine that starts at once and frees itself when it finishes; used to drive tasks
+    // from plain functions.
+    struct DetachedTask {
+      struct promise_type {
+        DetachedTask get_return_object() const noexcept {
+          return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+          return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+          return {};
+        }
+
+        void return_void() const noexcept {
+        }
+
+        void unhandled_exception() const noexcept {
+          std::terminate();
+        }
+      };
+    };
+  }
+
+  // Lazily started coroutine producing a T. The task starts when it is awaited, and the
+  // awaiting coroutine continues on whichever thread finishes it. Exceptions thrown by the
+  // task are rethrown to the awaiting coroutine.
+  template<typename T>
+  class AsyncTask {
+  public:
+    using promise_type = detail::AsyncTaskPromise<T>;
+
+  private:
+    std::coroutine_handle<promise_type> handle_;
+
+    struct Awaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept {
+        return handle.done();
+      }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+      }
+    };
+
+    struct ResultAwaiter : Awaiter {
+      T await_resume() {
+        return this->handle.promise().result();
+      }
+    };
+
+    struct ReadyAwaiter : Awaiter {
+      void await_resume() const noexcept {
+      }
+    };
+
+  public:
+    explicit AsyncTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {
+    }
+
+    AsyncTask(AsyncTask &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {
+    }
+
+    AsyncTask &operator=(AsyncTask &&other) noexcept {
+      if (this != &other) {
+        if (handle_) {
+          handle_.destroy();
+        }
+        handle_ = std::exchange(other.handle_, nullptr);
+      }
+      return *this;
+    }
+
+    AsyncTask(const AsyncTask &) = delete;
+    AsyncTask &operator=(const AsyncTask &) = delete;
+
+    ~AsyncTask() {
+      if (handle_) {
+        handle_.destroy();
+      }
+    }
+
+    ResultAwaiter operator co_await() const noexcept {
+      return ResultAwaiter{{handle_}};
+    }
+
+    // Waits for the task to finish without taking its result or rethrowing its exception.
+    ReadyAwaiter when_ready() const noexcept {
+      return ReadyAwaiter{{handle_}};
+    }
+
+    // Result of a finished task.
+    T result() const {
+      return handle_.promise().result();
+    }
+  };
+
+  namespace detail {
+    template<typename T>
+    AsyncTask<T> AsyncTaskPromise<T>::get_return_object() {
+      return AsyncTask<T>(std::coroutine_handle<AsyncTaskPromise<T>>::from_promise(*this));
+    }
+
+    inline AsyncTask<void> AsyncTaskPromise<void>::get_return_object() {
+      return AsyncTask<void>(std::coroutine_handle<AsyncTaskPromise<void>>::from_promise(*this));
+    }
+
+    // Resumes the awaiting coroutine once every started task has arrived.
+    class WhenAllLatch {
+    private:
+      std::atomic<std::size_t> remaining_;
+      std::coroutine_handle<> continuation_;
+
+    public:
+      explicit WhenAllLatch(std::size_t count) : remaining_(count + 1) {
+      }
+
+      void arrive() {
+        if (--remaining_ == 0) {
+          continuation_.resume();
+        }
+      }
+
+      bool await_ready() const noexcept {
+        return false;
+      }
+
+      bool await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        continuation_ = awaiting;
+        return --remaining_ > 0;
+      }
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    template<typename T>
+    DetachedTask start_for_latch(const AsyncTask<T> &task, WhenAllLatch &latch) {
+      co_await task.when_ready();
+      latch.arrive();
+    }
+
+    // The coroutine shares the promise, so it stays valid until set_value() has returned even
+    // when the waiting thread wakes up and leaves first.
+    template<typename T>
+    DetachedTask start_for_promise(const AsyncTask<T> &task,
+                                   std::shared_ptr<std::promise<void>> finished) {
+      co_await task.when_ready();
+      finished->set_value();
+    }
+  }
+
+  // Awaiting the result moves the coroutine onto a worker of the pool.
+  struct ResumeOn {
+    ThreadPool &pool;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+      pool.submit([handle]() { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+  inline ResumeOn resume_on(ThreadPool &pool) {
+    return ResumeOn{pool};
+  }
+
+  // Starts all tasks at once and finishes when the last of them has finished. When tasks throw,
+  // the first exception in task order is rethrown after all of them have finished.
+  template<typename T>
+  AsyncTask<std::vector<T>> when_all(std::vector<AsyncTask<T>> tasks) {
+    detail::WhenAllLatch latch(tasks.size());
+    for (const auto &task : tasks) {
+      detail::start_for_latch(task, latch);
+    }
+    co_await latch;
+
+    std::vector<T> results;
+    results.reserve(tasks.size());
+    for (const auto &task : tasks) {
+      results.push_back(task.result());
+    }
+    co_return results;
+  }
+
+  inline AsyncTask<void> when_all(std::vector<AsyncTask<void>> tasks) {
+    detail::WhenAllLatch latch(tasks.size());
+    for (const auto &task : tasks) {
+      detail::start_for_latch(task, latch);
+    }
+    co_await latch;
+
+    for (const auto &task : tasks) {
+      task.result();
+    }
+  }
+
+  // Runs the task from a thread outside the thread pools and blocks until it has finished.
+  template<typename T>
+  T sync_wait(AsyncTask<T> task) {
+    auto finished = std::make_shared<std::promise<void>>();
+    auto future = finished->get_future();
+    detail::start_for_promise(task, finished);
+    future.wait();
+    return task.result();
+  }
+}
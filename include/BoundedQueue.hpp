@@ -0,0 +1,89 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace WaterCoherer {
+  // Queue between two pipeline stages holding at most capacity items. A producer that finds the
+  // queue full waits until the consumer has taken an item, which bounds the memory held by
+  // items in flight. Closing the queue wakes both sides; items already queued can still be
+  // taken.
+  template<typename T>
+  class BoundedQueue {
+  private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+
+  public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // Returns false, dropping the item, when the queue has been closed.
+    bool push(T item) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+      if (closed_) {
+        return false;
+      }
+      items_.push_back(std::move(item));
+      lock.unlock();
+      not_empty_.notify_one();
+      return true;
+    }
+
+    // Returns false once the queue is closed and empty.
+    bool pop(T &item) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+      if (items_.empty()) {
+        return false;
+      }
+      item = std::move(items_.front());
+      items_.pop_front();
+      lock.unlock();
+      not_full_.notify_one();
+      return true;
+    }
+
+    void close() {
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        closed_ = true;
+      }
+      not_empty_.notify_all();
+      not_full_.notify_all();
+    }
+  };
+}
@@ -23,14 +23,17 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "WaterCohererTypes.hpp"
+#include "TiledMask.hpp"
 #include "CImage.hpp"
 #include <vector>
 
 namespace WaterCoherer {
   class CloudDetection {
   public:
-    static PixelPositions localize_clouds(const TiffImage &, unsigned int);
+    static PixelMask localize_clouds(const TiffImage &, unsigned int);
 
-    static TiffImage generate_cloud_layer(const PixelPositions &, unsigned int, unsigned int);
+    static TiledMask localize_clouds_tiled(const TiffImage &, unsigned int);
+
+    static TiffImage generate_cloud_layer(const PixelMask &, unsigned int, unsigned int);
   };
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "GeoReference.hpp"
+#include "WaterCohererTypes.hpp"
+#include <string>
+
+namespace WaterCoherer {
+  // Writes 8-bit layers with one or three channels as Cloud Optimized GeoTIFF: the layer is cut
+  // into tiles and followed by overviews, each half the size of the previous one, down to a
+  // single tile. All image directories come first and tile data follows from the smallest
+  // overview to the full resolution, so a reader fetches the directories with one request
+  // and then only the tiles and zoom levels it needs.
+  //
+  // Overviews take the top-left pixel of every 2x2 block, which keeps the class values of masks
+  // and water type layers intact. All levels are derived and all of their tiles compressed in
+  // one parallel pass; the compressed tiles are held until the file is written. Files that
+  // would exceed 4 GiB are written as BigTIFF.
+  class CogWriter {
+  public:
+    enum class Compression {
+      Deflate,
+      Lzw,
+      Zstd
+    };
+
+    static constexpr unsigned int tile_size = 512;
+
+    // Returns false, after a warning, when the layer cannot be written; a partly written file
+    // is removed. Zstd falls back to Deflate, after a warning, when it is not built in.
+    static bool save(const TiffImage &layer, const std::string &path, unsigned int cores,
+                     const GeoReference &georeference = GeoReference(),
+                     Compression compression = Compression::Deflate);
+
+    // Writes the mask as a bilevel image, one bit per pixel packed straight from its words.
+    // Overviews keep the top-left bit of every 2x2 block as well.
+    static bool save(const PixelMask &mask, const std::string &path, unsigned int cores,
+                     const GeoReference &georeference = GeoReference(),
+                     Compression compression = Compression::Deflate);
+  };
+}
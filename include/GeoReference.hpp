@@ -0,0 +1,108 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct tiff;
+
+namespace WaterCoherer {
+  class TiffBuffer;
+
+  // Rectangle of pixels of a scene.
+  struct PixelWindow {
+    unsigned int x = 0;
+    unsigned int y = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    // Whether the window is not empty and lies inside a raster of the size. Nothing is summed,
+    // so windows near the limits of unsigned int cannot wrap around into the raster.
+    bool fits_into(unsigned int raster_width, unsigned int raster_height) const {
+      return width > 0 && height > 0 && x < raster_width && width <= raster_width - x &&
+             y < raster_height && height <= raster_height - y;
+    }
+  };
+
+  // Rectangle in the map coordinates of a scene's coordinate reference system, e.g. UTM metres
+  // for Landsat products.
+  struct MapBoundingBox {
+    double min_x;
+    double min_y;
+    double max_x;
+    double max_y;
+  };
+
+  // Placement of a north-up GeoTIFF raster on the map: the size of a pixel and the map
+  // coordinates of the outer corner of pixel (0, 0), taken from the ModelPixelScale and
+  // ModelTiepoint tags. The GeoKey directory describing the coordinate reference system is
+  // kept as it is, so outputs can be georeferenced like their input.
+  class GeoReference {
+  private:
+    bool valid_ = false;
+    double pixel_width_ = 0.;
+    double pixel_height_ = 0.;
+    double origin_x_ = 0.;
+    double origin_y_ = 0.;
+    std::vector<uint16_t> geo_keys_;
+    std::vector<double> geo_doubles_;
+    std::string geo_ascii_;
+
+    // Closes the handle.
+    static GeoReference read(tiff *handle);
+
+  public:
+    static constexpr uint32_t model_pixel_scale_tag = 33550;
+    static constexpr uint32_t model_tiepoint_tag = 33922;
+    static constexpr uint32_t geo_key_directory_tag = 34735;
+    static constexpr uint32_t geo_double_params_tag = 34736;
+    static constexpr uint32_t geo_ascii_params_tag = 34737;
+
+    // Makes libtiff read and write the GeoTIFF tags above as regular fields. Called by every
+    // function of the tree that opens TIFF files with georeference.
+    static void register_tags();
+
+    // Returns an invalid reference when the file has no usable GeoTIFF tags.
+    static GeoReference read(const std::string &path);
+    static GeoReference read(const TiffBuffer &buffer);
+
+    bool valid() const;
+    double pixel_width() const;
+    double pixel_height() const;
+    double origin_x() const;
+    double origin_y() const;
+    const std::vector<uint16_t> &geo_keys() const;
+    const std::vector<double> &geo_doubles() const;
+    const std::string &geo_ascii() const;
+
+    // Reference of a raster cut out of this one.
+    GeoReference window(const PixelWindow &) const;
+
+    // Pixels of a width x height raster covering the bounding box, clipped to the raster. The
+    // window is empty when the box misses the raster or any of its edges is not finite.
+    PixelWindow pixel_window(const MapBoundingBox &, unsigned int width,
+                             unsigned int height) const;
+  };
+}
@@ -22,22 +22,89 @@
 //  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 //  DEALINGS IN THE SOFTWARE.
 
+#include "GeoReference.hpp"
+#include "MappedTiff.hpp"
+#include "ThreadPool.hpp"
+#include "TiffBuffer.hpp"
 #include "WaterCohererTypes.hpp"
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
 
 namespace WaterCoherer {
+  // Bands of a scene. Loading only indexes the band files of the scene directory; a band is
+  // decoded the first time it is viewed, so runs that need a few bands never decode the others.
+  // Concurrent first views of a band decode it once. prefetch() decodes bands known to be
+  // needed ahead of time, all of them at once.
+  //
+  // Scenes may also be loaded straight from their .tar.gz archive without extracting it. The
+  // archive is inflated once while loading and its band files are kept encoded in memory; they
+  // are then decoded lazily like files, with strips of every band decoded in parallel.
   class LandsatImage {
+  public:
+    enum class Band {
+      Blue,
+      Green,
+      Red,
+      NearInfrared,
+      ShortwaveInfrared,
+      Thermal
+    };
+
   private:
+    struct LazyLayer {
+      // Empty for bands read out of an archive.
+      std::string path;
+      // Band read out of an archive, until it has been decoded.
+      std::unique_ptr<TiffBuffer> buffer;
+      std::once_flag decoded;
+      TiffImage image;
+      // File that image is a shared view of, when it could be mapped.
+      std::shared_ptr<const MappedTiff> mapped_file;
+    };
+
     int widht_ = 0;
     int height_ = 0;
     std::string image_descripton_;
-    ImageLayers image_layers_;
-    void push_back_image_layer(const TiffImage&, const std::string&, int);
+    std::map<std::string, std::unique_ptr<LazyLayer>> image_layers_;
+    std::optional<PixelWindow> window_;
+    GeoReference georeference_;
+    bool index_scene(const char *);
+    bool list_layer_files(const char *);
+    bool read_archive_layers(const char *);
+    void describe_layers(const PixelWindow *);
+    void push_back_image_layer(const std::string&, int, std::unique_ptr<TiffBuffer>);
+    void decode_layer(LazyLayer&, ThreadPool&) const;
+    const TiffImage& get_decoded_layer(LazyLayer&, ThreadPool&) const;
     const TiffImage& get_image_layer(const std::string&);
+    static const char *layer_name(Band);
+    static const char *layer_name(int);
+    static int layer_index(const std::string&);
+    static GeoReference read_georeference(const LazyLayer&);
+    static bool read_size(const LazyLayer&, unsigned int&, unsigned int&);
 
   public:
     LandsatImage() = default;
     ~LandsatImage() = default;
+    LandsatImage(LandsatImage&&) = default;
+    LandsatImage& operator=(LandsatImage&&) = default;
+    // Takes a scene directory or a .tar, .tar.gz or .tgz archive of one.
     void load_image(const char *input_directory_path);
+    // Loads only the window of every band, decoding just the strips or tiles it touches. The
+    // layers and the georeference then describe the window instead of the whole scene.
+    void load_image(const char *input_directory_path, const PixelWindow &window);
+    void load_image(const char *input_directory_path, const MapBoundingBox &bounding_box);
+    // Decodes the bands that are not decoded yet, reading them on the pool's workers; bands
+    // missing from the scene are skipped. Mapped bands have all of their pages read in.
+    void prefetch(std::initializer_list<Band> bands, ThreadPool &pool = ThreadPool::instance());
+    // File of the band, or an empty string when the scene lacks it or was loaded from an archive.
+    std::string band_path(Band band) const;
+    // Invalid when the bands carry no GeoTIFF tags.
+    const GeoReference& georeference() const;
     int width() const;
     int height() const;
     const TiffImage& view_red_layer();
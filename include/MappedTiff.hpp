@@ -0,0 +1,60 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "WaterCohererTypes.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace WaterCoherer {
+  class ThreadPool;
+
+  // Band of an uncompressed TIFF file viewed straight from the page cache. The file is mapped
+  // read-only and view() is a shared CImg over the mapped pixels, so loading copies nothing
+  // and repeated runs over cached scenes read no file data at all. Copies of the view stay
+  // shared and are valid as long as the MappedTiff lives; the pixels must not be written.
+  class MappedTiff {
+  private:
+    void *address_ = nullptr;
+    std::size_t size_ = 0;
+    TiffImage view_;
+
+    MappedTiff() = default;
+
+  public:
+    MappedTiff(const MappedTiff &) = delete;
+    MappedTiff &operator=(const MappedTiff &) = delete;
+    ~MappedTiff();
+
+    // Maps 8-bit single band files whose uncompressed strips are stored back to back, as in
+    // Landsat products. Returns nullptr for every other file, which then has to be decoded.
+    static std::shared_ptr<const MappedTiff> open(const std::string &path);
+
+    const TiffImage &view() const;
+
+    // Faults every page of the pixels in on the pool's workers, so the kernels that view the
+    // band later do not wait for the disk.
+    void read_pages(ThreadPool &pool) const;
+  };
+}
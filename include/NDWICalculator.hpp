@@ -23,6 +23,9 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "CImage.hpp"
+#include "RunLengthMask.hpp"
+#include "TiledMask.hpp"
+#include "TwoBandLookupTable.hpp"
 #include "WaterCohererTypes.hpp"
 #include "WaterDifferencer.hpp"
 
@@ -53,9 +56,28 @@ namespace WaterCoherer {
     generate_ndwi_layer_high_performance(const TiffImage &, const TiffImage &, Method,
                                          unsigned int);
 
-    static PixelPositions localize_water(unsigned int, const TiffImage &, const TiffImage &);
+    // Classification tables of the methods at their default thresholds.
+    static const TwoBandLookupTable &lookup_table(Method);
 
-    static PixelPositions localize_water(unsigned int, const TiffImage &, const TiffImage &,
-      const PixelPositions&);
+    static TwoBandLookupTable lookup_table(Method, float);
+
+    static PixelMask localize_water(unsigned int, const TiffImage &, const TiffImage &);
+
+    static PixelMask localize_water(unsigned int, const TiffImage &, const TiffImage &,
+      const TwoBandLookupTable&);
+
+    static PixelMask localize_water(unsigned int, const TiffImage &, const TiffImage &,
+      const TwoBandLookupTable&, const PixelMask&);
+
+    static PixelMask localize_water(unsigned int, const TiffImage &, const TiffImage &,
+      const PixelMask&);
+
+    static PixelMask localize_water(unsigned int, const TiffImage &, const TiffImage &,
+      const RunLengthMask&);
+
+    static TiledMask localize_water_tiled(unsigned int, const TiffImage &, const TiffImage &);
+
+    static TiledMask localize_water_tiled(unsigned int, const TiffImage &, const TiffImage &,
+      const TiledMask&);
   };
 }  // namespace WaterCoherer
@@ -0,0 +1,54 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <vector>
+
+namespace WaterCoherer {
+  // NUMA nodes of the machine and the logical processors attached to them, read from
+  // /sys/devices/system/node. Nodes without processors are left out, so nodes are numbered
+  // densely from 0. Machines without the sysfs entries are treated as a single node.
+  class NumaTopology {
+  private:
+    std::vector<std::vector<unsigned int>> node_cpus_;
+    std::vector<unsigned int> cpu_nodes_;
+
+    NumaTopology();
+
+  public:
+    static const NumaTopology &instance();
+
+    unsigned int node_count() const;
+
+    const std::vector<unsigned int> &node_cpus(unsigned int node) const;
+
+    unsigned int node_of_cpu(unsigned int cpu) const;
+
+    // Node of the processor the calling thread is running on.
+    unsigned int current_node() const;
+
+    // Restricts the calling thread to the given processors. Returns false when the processors
+    // cannot be set, leaving the thread unpinned.
+    static bool pin_current_thread(const std::vector<unsigned int> &cpus);
+  };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace WaterCoherer {
+  // Binary raster mask storing one bit per pixel. Every row starts on a new word, so rows can be
+  // written by different workers without sharing memory and scanned one word at a time.
+  class PixelMask {
+  public:
+    using Word = std::uint64_t;
+    static constexpr unsigned int word_bits = 64;
+
+  private:
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    std::size_t words_per_row_ = 0;
+    std::vector<Word> words_;
+
+  public:
+    PixelMask() = default;
+    PixelMask(unsigned int width, unsigned int height);
+
+    static std::size_t words_for_width(unsigned int width) {
+      return (width + word_bits - 1) / word_bits;
+    }
+
+    unsigned int width() const;
+    unsigned int height() const;
+    std::size_t words_per_row() const;
+    bool same_size(const PixelMask &) const;
+
+    bool test(unsigned int x, unsigned int y) const {
+      return (words_[y * words_per_row_ + x / word_bits] >> (x % word_bits)) & 1U;
+    }
+
+    void set(unsigned int x, unsigned int y) {
+      words_[y * words_per_row_ + x / word_bits] |= Word{1} << (x % word_bits);
+    }
+
+    void reset(unsigned int x, unsigned int y) {
+      words_[y * words_per_row_ + x / word_bits] &= ~(Word{1} << (x % word_bits));
+    }
+
+    Word *row(unsigned int y) {
+      return words_.data() + y * words_per_row_;
+    }
+
+    const Word *row(unsigned int y) const {
+      return words_.data() + y * words_per_row_;
+    }
+
+    // Copies pixels x_begin .. x_begin + count - 1 of row y, x_begin being a multiple of 8, in
+    // the bit order of bilevel TIFF images: eight pixels per byte, the first one in the most
+    // significant bit. Pixels past the mask's width are written as zero.
+    void pack_msb_first(unsigned int y, unsigned int x_begin, unsigned int count,
+                        unsigned char *bytes) const;
+
+    // Reverse of pack_msb_first; bits past the mask's width are ignored.
+    void unpack_msb_first(unsigned int y, unsigned int x_begin, unsigned int count,
+                          const unsigned char *bytes);
+
+    std::size_t count() const;
+
+    bool any() const;
+
+    PixelMask &operator|=(const PixelMask &);
+
+    PixelMask &operator&=(const PixelMask &);
+
+    PixelMask &subtract(const PixelMask &);
+
+    template<typename Function>
+    void for_each(Function function) const {
+      for (unsigned int y = 0; y < height_; ++y) {
+        const Word *words = row(y);
+        for (std::size_t i = 0; i < words_per_row_; ++i) {
+          Word word = words[i];
+          while (word) {
+            auto x = static_cast<unsigned int>(i * word_bits + __builtin_ctzll(word));
+            function(x, y);
+            word &= word - 1;
+          }
+        }
+      }
+    }
+  };
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "PixelMask.hpp"
+#include <cstddef>
+
+namespace WaterCoherer {
+  // Row kernels shared by every raster stage. Each kernel has a scalar implementation and SSE2,
+  // AVX2 and AVX-512 implementations; the widest one supported by the processor is selected at
+  // run time. The kernels only compare, look up and combine integers, so every implementation
+  // is bit-exact with the scalar path. Band indices such as the NDWI are classified through
+  // TwoBandLookupTable.
+  //
+  // Classification kernels pack their result into mask words, bit x of word x / 64 describing
+  // pixel x of the row.
+  class RasterKernels {
+  public:
+    using Word = PixelMask::Word;
+
+    enum class InstructionSet {
+      Scalar,
+      SSE2,
+      AVX2,
+      AVX512
+    };
+
+    static InstructionSet best_instruction_set();
+
+    static InstructionSet instruction_set();
+
+    // Selects the implementation used by all kernels. Returns false and keeps the current
+    // selection when the processor does not support the requested instruction set.
+    static bool use_instruction_set(InstructionSet);
+
+    // Sets the bit of every value greater than the threshold.
+    static void threshold_above(const unsigned char *values, unsigned int width,
+                                unsigned char threshold, Word *words);
+
+    // Sets the bit of every pixel whose entry in a 256 x 256 table indexed by
+    // first << 8 | second is non-zero. The table must be readable 3 bytes past its end.
+    static void lookup_two_band(const unsigned char *table, const unsigned char *first,
+                                const unsigned char *second, unsigned int width, Word *words);
+
+    static void unite(Word *words, const Word *other, std::size_t size);
+
+    static void subtract(Word *words, const Word *omitted, std::size_t size);
+
+    // Writes 255 for every set bit and 0 for every unset bit.
+    static void expand(const Word *words, unsigned int width, unsigned char *pixels);
+
+    // Splits water pixels by their near infrared value: pixels above the threshold are written
+    // to bright, the remaining water pixels to dark.
+    static void split_water_types(const Word *water, const unsigned char *nir, unsigned int width,
+                                  unsigned char threshold, unsigned char *bright,
+                                  unsigned char *dark);
+  };
+}
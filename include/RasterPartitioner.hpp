@@ -0,0 +1,98 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace WaterCoherer {
+  // Rectangle [x_begin, x_end) x [y_begin, y_end) of a raster.
+  struct RasterTile {
+    unsigned int x_begin;
+    unsigned int x_end;
+    unsigned int y_begin;
+    unsigned int y_end;
+
+    unsigned int width() const {
+      return x_end - x_begin;
+    }
+
+    unsigned int height() const {
+      return y_end - y_begin;
+    }
+  };
+
+  // Splits a raster into small tiles that workers take one at a time, so workers that hit
+  // nodata borders simply take more tiles and all of them finish together. Tiles are handed
+  // out row by row; tile widths are multiples of the mask word size, so tiles of the same rows
+  // never share a mask word and may be written without synchronisation.
+  //
+  // On NUMA machines the tile rows are split into one contiguous range per node. Workers take
+  // the tiles of their own node first and only then help with the other ranges, so the same
+  // rows keep being handled on the same node: buffers first touched through a partitioner
+  // stay local to the workers that process them later.
+  class RasterPartitioner {
+  public:
+    // A tile of 2048 x 16 pixels covers 32 KiB of each band.
+    static constexpr unsigned int default_tile_width = 2048;
+    static constexpr unsigned int default_tile_height = 16;
+
+  private:
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int tile_width_;
+    unsigned int tile_height_;
+    unsigned int tiles_x_;
+    unsigned int tiles_y_;
+
+    struct alignas(64) NodeRange {
+      std::atomic<unsigned int> next{0};
+      unsigned int end = 0;
+    };
+
+    unsigned int node_count_;
+    std::unique_ptr<NodeRange[]> ranges_;
+
+  public:
+    RasterPartitioner(unsigned int width, unsigned int height,
+                      unsigned int tile_width = default_tile_width,
+                      unsigned int tile_height = default_tile_height);
+
+    RasterPartitioner(const RasterPartitioner &) = delete;
+    RasterPartitioner &operator=(const RasterPartitioner &) = delete;
+
+    unsigned int tiles_x() const;
+    unsigned int tiles_y() const;
+    unsigned int tile_count() const;
+
+    RasterTile tile(unsigned int index) const;
+
+    // Takes the next tile that no worker has taken yet. Returns false when all are taken.
+    bool next(RasterTile &);
+
+    // Runs function on every tile, using up to cores tasks of the shared thread pool, and
+    // returns when all tiles are done.
+    void run(unsigned int cores, const std::function<void(const RasterTile &)> &function);
+  };
+}
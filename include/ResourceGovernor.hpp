@@ -0,0 +1,132 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace WaterCoherer {
+  // Counting semaphore for scenes held in memory. Threads acquire a slot by blocking: they run
+  // queued tasks of the shared pool until none are left, so that pool workers can wait too,
+  // and then sleep until a slot is released. Coroutines await a slot without holding a thread.
+  class SceneSlots {
+  private:
+    std::size_t available_;
+    std::deque<std::coroutine_handle<>> waiting_coroutines_;
+    std::mutex mutex_;
+    std::condition_variable released_;
+
+  public:
+    explicit SceneSlots(std::size_t);
+
+    SceneSlots(const SceneSlots &) = delete;
+    SceneSlots &operator=(const SceneSlots &) = delete;
+
+    bool try_acquire();
+
+    void acquire();
+
+    // A released slot goes to a waiting coroutine first, which resumes on the shared pool.
+    void release();
+
+    struct Awaiter {
+      SceneSlots &slots;
+
+      bool await_ready() const {
+        return slots.try_acquire();
+      }
+
+      bool await_suspend(std::coroutine_handle<>);
+
+      void await_resume() const noexcept {
+      }
+    };
+
+    Awaiter acquire_async() {
+      return Awaiter{*this};
+    }
+  };
+
+  // Slot of SceneSlots owned by one scene, released when the slot is destroyed or released.
+  class SceneSlot {
+  private:
+    SceneSlots *slots_ = nullptr;
+
+  public:
+    SceneSlot() = default;
+
+    // Blocks until a slot is acquired, see SceneSlots::acquire.
+    explicit SceneSlot(SceneSlots &);
+
+    SceneSlot(SceneSlot &&) noexcept;
+    SceneSlot &operator=(SceneSlot &&) noexcept;
+    ~SceneSlot();
+
+    void release();
+  };
+
+  // Processor and memory budget of the process. Besides the processors the kernel lets the
+  // process run on, CPU bandwidth quotas and memory limits of the process' cgroup are honoured,
+  // for both cgroup v1 and v2; in a container with a quota of 4 processors the pool gets 4
+  // workers, whatever the size of the host.
+  class ResourceGovernor {
+  public:
+    // Decoded bands and masks of a Landsat 7 scene of about 8000 x 7000 pixels.
+    static constexpr std::size_t scene_bytes = std::size_t{512} << 20;
+
+  private:
+    unsigned int processors_;
+    std::size_t memory_limit_;
+    SceneSlots scene_slots_;
+
+    ResourceGovernor(unsigned int processors, std::size_t memory_limit);
+
+  public:
+    static ResourceGovernor &instance();
+
+    // Number of worker threads to use for raster stages.
+    unsigned int processors() const;
+
+    // Bytes of memory available to the process.
+    std::size_t memory_limit() const;
+
+    // Scenes that may be loaded at once: three quarters of the memory limit in scene_bytes,
+    // and at least one.
+    std::size_t max_scenes_in_memory() const;
+
+    // A slot must be held from loading a scene until its bands are released.
+    SceneSlots &scene_slots();
+
+    // Contents of cgroup v2 cpu.max, "<quota> <period>" or "max <period>". Gives the processors
+    // the quota allows, 0 without a quota; returns false for contents of any other form.
+    static bool parse_cpu_max(const std::string &contents, double &processors);
+
+    // Contents of cgroup v2 memory.max, a number of bytes or "max". Gives the limit, 0 without
+    // one; returns false for contents of any other form.
+    static bool parse_memory_max(const std::string &contents, std::size_t &bytes);
+  };
+}
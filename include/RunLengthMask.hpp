@@ -0,0 +1,86 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "WaterCohererTypes.hpp"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace WaterCoherer {
+  // Binary raster mask stored as sorted, non-overlapping runs [begin, end) of set pixels per row.
+  // Spatially coherent masks such as clouds or water bodies need only a few runs per row, and set
+  // algebra works in time proportional to the number of runs.
+  class RunLengthMask {
+  public:
+    struct Run {
+      unsigned int begin;
+      unsigned int end;
+    };
+
+  private:
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    std::vector<Run> runs_;
+    std::vector<std::size_t> row_offsets_;
+
+    void push_back_run(unsigned int begin, unsigned int end);
+    void finish_row();
+
+  public:
+    RunLengthMask() = default;
+    RunLengthMask(unsigned int width, unsigned int height);
+
+    static RunLengthMask from_layer(const TiffImage &);
+
+    static RunLengthMask from_pixel_mask(const PixelMask &);
+
+    PixelMask to_pixel_mask() const;
+
+    unsigned int width() const;
+    unsigned int height() const;
+    std::size_t count() const;
+    std::size_t run_count() const;
+    bool same_size(const RunLengthMask &) const;
+
+    // True for a default constructed mask, which has no rows to look at.
+    bool empty() const;
+
+    const Run *row_begin(unsigned int y) const {
+      return runs_.data() + row_offsets_[y];
+    }
+
+    const Run *row_end(unsigned int y) const {
+      return runs_.data() + row_offsets_[y + 1];
+    }
+
+    static RunLengthMask unite(const RunLengthMask &, const RunLengthMask &);
+
+    static RunLengthMask intersect(const RunLengthMask &, const RunLengthMask &);
+
+    static RunLengthMask subtract(const RunLengthMask &, const RunLengthMask &);
+  };
+
+  using RunLengthMaskLayers = std::map<std::string, RunLengthMask>;
+}
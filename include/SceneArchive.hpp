@@ -0,0 +1,50 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace WaterCoherer {
+  // Landsat products as delivered: a tar archive of the band files, usually gzip compressed.
+  // Neither format can be entered in the middle, so the archive is inflated and walked once, in
+  // member order. Members are read straight into memory; members nobody wants are skipped on
+  // the way. ustar, GNU long name and pax path headers are understood.
+  class SceneArchive {
+  public:
+    // Tells archives from scene directories by their extension: .tar, .tar.gz or .tgz.
+    static bool is_archive(const std::string &path);
+
+    // Name of the scene in a directory or archive path: the last path component without
+    // trailing separators or archive extension.
+    static std::string scene_name(const std::string &path);
+
+    // Hands every regular file member whose name wanted accepts to read, whole, as soon as it
+    // has been inflated. Names are the members' file names without their directories. Returns
+    // false, after a warning, when the archive cannot be read or ends inside a member.
+    static bool read_members(
+      const std::string &path, const std::function<bool(const std::string &)> &wanted,
+      const std::function<void(const std::string &, std::vector<unsigned char>)> &read);
+  };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "WaterCohererTypes.hpp"
+#include "TwoBandLookupTable.hpp"
+
+namespace WaterCoherer {
+  struct SceneClassification {
+    PixelMask clouds;
+    PixelMask water;
+    // Water whose near infrared value marks it as the bright water type of WaterDifferencer.
+    PixelMask bright_water;
+  };
+
+  // Fused per-scene mode: the blue, green and near infrared bands are read once, row by row,
+  // and the cloud mask, water mask and water type are all classified while the rows are in
+  // cache. Water is not cleared of clouds; subtract the cloud mask of interest afterwards.
+  class SceneClassifier {
+  public:
+    static SceneClassification classify(unsigned int, const TiffImage &, const TiffImage &,
+                                        const TiffImage &);
+
+    static SceneClassification classify(unsigned int, const TiffImage &, const TiffImage &,
+                                        const TiffImage &, const TwoBandLookupTable &);
+  };
+}
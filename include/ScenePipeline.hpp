@@ -0,0 +1,63 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "GeoReference.hpp"
+#include "WaterCohererTypes.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace WaterCoherer {
+  // Processes a batch of scenes in three overlapped stages: loading, classification and
+  // writing. While one scene is classified, the next one is loaded and the previous one is
+  // written. Stages are joined by bounded queues, so a slow stage holds the others back and at
+  // most queue_capacity scenes wait between two stages. Loaded scenes also hold a slot of
+  // ResourceGovernor until their bands are released, which caps the scenes in memory across
+  // all pipelines of the process.
+  //
+  // Scenes are directories of band files or .tar.gz archives of them, read without extraction.
+  // For every scene, <output directory>/<scene>_water.tif and <scene>_clouds.tif are written;
+  // the water mask is cleared of the scene's own clouds. Outputs are georeferenced like the
+  // scene, or like the region of interest when the pipeline is restricted to one.
+  class ScenePipeline {
+  private:
+    unsigned int cores_;
+    std::size_t queue_capacity_;
+    std::optional<PixelWindow> window_;
+    std::optional<MapBoundingBox> bounding_box_;
+
+  public:
+    explicit ScenePipeline(unsigned int cores, std::size_t queue_capacity = 1);
+
+    // Loads and processes only this region of every scene.
+    void restrict_to(const PixelWindow &window);
+    void restrict_to(const MapBoundingBox &bounding_box);
+
+    // Returns once every scene has been written. The first exception thrown by a stage stops
+    // the pipeline and is rethrown.
+    void run(const std::vector<std::string> &scene_directories,
+             const std::string &output_directory);
+  };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <string>
+
+namespace WaterCoherer {
+  // Classifies bands of any size a chunk of rows at a time. The bands are read through
+  // TiffStripReader, CloudDetection and NDWICalculator classify every chunk and TiffStripWriter
+  // writes the masks as they are produced. Both stages look at single pixels only, so the masks
+  // are those ScenePipeline writes for the same bands: clouds, and water cleared of them.
+  //
+  // A chunk spans the tallest strip, or row of tiles, of the bands, rounded up to whole strips
+  // of the outputs, and the full width. Memory therefore holds, per band, the decoded strip and
+  // one chunk of 8-bit pixels, plus one chunk of both masks. Output strips hold 64 KiB of mask
+  // bits, so for bands stored in tall strips, at worst a single one, the strips set the bound.
+  class StreamingClassifier {
+  public:
+    // Writes <output directory>/<scene>_water.tif and <scene>_clouds.tif of a scene directory.
+    // Scene archives are refused with a warning; ScenePipeline reads them without extraction.
+    static bool classify(const std::string &scene_directory, const std::string &output_directory,
+                         unsigned int cores);
+
+    // Works on single band files of any origin, e.g. mosaics, georeferenced like the green band.
+    // Returns false, after a warning, when the bands differ in size or a file cannot be read or
+    // written; incomplete outputs are removed.
+    static bool classify(const std::string &blue_path, const std::string &green_path,
+                         const std::string &nir_path, const std::string &water_path,
+                         const std::string &clouds_path, unsigned int cores);
+  };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+namespace WaterCoherer {
+  // Tasks with dependencies, run on the shared thread pool. A task is queued as soon as the
+  // last task it depends on has finished, so independent chains run concurrently and only
+  // tasks with several dependencies act as join points. Dependencies must be added before their
+  // dependents, which keeps the graph acyclic.
+  class TaskGraph {
+  public:
+    using Node = std::size_t;
+
+  private:
+    struct Task {
+      ThreadPool::Task function;
+      std::vector<Node> dependents;
+      std::size_t dependencies = 0;
+      std::atomic<std::size_t> remaining{0};
+    };
+
+    ThreadPool &pool_;
+    std::vector<std::unique_ptr<Task>> tasks_;
+
+    void schedule(TaskGroup &, Node);
+
+  public:
+    explicit TaskGraph(ThreadPool & = ThreadPool::instance());
+
+    TaskGraph(const TaskGraph &) = delete;
+    TaskGraph &operator=(const TaskGraph &) = delete;
+
+    Node add(ThreadPool::Task, std::initializer_list<Node> = {});
+
+    Node add(ThreadPool::Task, const std::vector<Node> &);
+
+    std::size_t size() const;
+
+    // Runs every task once and returns when all of them have finished. When a task throws, the
+    // tasks depending on it are not run and the first exception is rethrown.
+    void run();
+  };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WaterCoherer {
+  // Persistent work-stealing pool shared by every stage. Each worker keeps its own queue: tasks
+  // submitted from a worker go to the back of its queue and are run newest first, idle workers
+  // steal the oldest tasks from the others. Tasks submitted from outside the pool are spread
+  // over the queues.
+  class ThreadPool {
+  public:
+    using Task = std::function<void()>;
+
+  private:
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> next_queue_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_condition_;
+    bool stop_ = false;
+
+    void work(unsigned int);
+    bool pop(unsigned int, Task &);
+    bool steal(unsigned int, Task &);
+
+  public:
+    // Workers pinned to nodes are spread evenly over the NUMA nodes and may run on any
+    // processor of their node.
+    explicit ThreadPool(unsigned int, bool pin_to_nodes = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Pool used by all stages, with one worker per processor granted by ResourceGovernor.
+    static ThreadPool &instance();
+
+    unsigned int size() const;
+
+    void submit(Task);
+
+    // Runs one queued task on the calling thread, preferring the caller's own queue. Returns
+    // false when no task was queued.
+    bool run_pending_task();
+
+    // Runs function(0) ... function(count - 1) as separate tasks and returns when all of them
+    // have finished. The calling thread runs queued tasks while it waits.
+    void parallel_for(unsigned int count, const std::function<void(unsigned int)> &function);
+  };
+
+  // Set of tasks that can be waited for together. Waiting threads keep running queued tasks, so
+  // tasks may themselves wait for nested groups without starving the pool. The first exception
+  // thrown by a task is rethrown by wait().
+  class TaskGroup {
+  private:
+    ThreadPool &pool_;
+    std::atomic<std::size_t> pending_{0};
+    std::mutex mutex_;
+    std::condition_variable finished_;
+    std::exception_ptr error_;
+
+  public:
+    explicit TaskGroup(ThreadPool & = ThreadPool::instance());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void run(ThreadPool::Task);
+
+    void wait();
+  };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <string>
+#include <vector>
+
+struct tiff;
+
+namespace WaterCoherer {
+  // Encoded TIFF file held in memory, such as a band read out of a scene archive. Every open()
+  // returns an independent read-only libtiff handle over the same bytes, so bands in memory are
+  // decoded by parallel workers just like files. The bytes must outlive the handles.
+  class TiffBuffer {
+  private:
+    std::string name_;
+    std::vector<unsigned char> bytes_;
+
+  public:
+    TiffBuffer(std::string name, std::vector<unsigned char> bytes);
+
+    // Labels warnings about the buffer, as a path does for files.
+    const std::string &name() const;
+    const std::vector<unsigned char> &bytes() const;
+
+    // Returns nullptr when the bytes are no TIFF file. Close the handle with TIFFClose.
+    tiff *open() const;
+  };
+}
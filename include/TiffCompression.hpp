@@ -0,0 +1,52 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <cstddef>
+#include <vector>
+
+namespace WaterCoherer {
+  // Encoders of the compression schemes TIFF strips and tiles are written with. They keep no
+  // state between calls, so any number of blocks can be encoded at the same time.
+  class TiffCompression {
+  public:
+    // Values of the Compression tag.
+    static constexpr unsigned short lzw_tag = 5;
+    static constexpr unsigned short deflate_tag = 8;
+    static constexpr unsigned short zstd_tag = 50000;
+
+    // zlib stream, as libtiff writes for COMPRESSION_ADOBE_DEFLATE.
+    static bool deflate(const unsigned char *data, std::size_t size,
+                        std::vector<unsigned char> &output);
+
+    // TIFF flavour of LZW: codes are packed most significant bit first and widen one code
+    // early, exactly like libtiff's encoder, so every TIFF reader decodes them.
+    static void lzw(const unsigned char *data, std::size_t size,
+                    std::vector<unsigned char> &output);
+
+    // Only available when built with WATERCOHERER_USE_ZSTD; returns false otherwise.
+    static bool zstd(const unsigned char *data, std::size_t size,
+                     std::vector<unsigned char> &output);
+    static bool zstd_available();
+  };
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "GeoReference.hpp"
+#include "ThreadPool.hpp"
+#include "TiffBuffer.hpp"
+#include "WaterCohererTypes.hpp"
+#include <string>
+#include <vector>
+
+struct tiff;
+
+namespace WaterCoherer {
+  // Loads single band TIFF files. Strip organised 8-bit bands are decoded in parallel: every
+  // worker opens its own libtiff handle, takes whole strips one at a time and decodes them
+  // straight into their rows of the image; tiled 8-bit bands are decoded tile by tile. Any other
+  // layout is left to CImg, which reads files only. Windows of 8-bit bands decode only the
+  // strips or tiles they intersect. Bands held in a TiffBuffer are decoded the same way.
+  // Workers take the blocks of their own NUMA node's rows first, as with RasterPartitioner, so
+  // decoding places the rows on the node that processes them later.
+  // Reading and decoding run on the given pool, so I/O bound callers can keep them off the
+  // shared one.
+  class TiffReader {
+  public:
+    // Returns an empty image, after a warning, when a strip cannot be decoded.
+    static TiffImage load(const std::string &path, unsigned int cores,
+                          ThreadPool &pool = ThreadPool::instance());
+    static TiffImage load(const TiffBuffer &buffer, unsigned int cores,
+                          ThreadPool &pool = ThreadPool::instance());
+
+    // Reads a mask written one bit per pixel, unpacking its rows straight into the mask's
+    // words, or one byte per pixel with any non-zero value set. Returns an empty mask, after a
+    // warning, for any other file.
+    static PixelMask load_mask(const std::string &path, unsigned int cores);
+
+    // Reads the band's size without decoding it.
+    static bool read_size(const std::string &path, unsigned int &width, unsigned int &height);
+    static bool read_size(const TiffBuffer &buffer, unsigned int &width, unsigned int &height);
+
+    // Returns an empty image, after a warning, when the window does not fit into the band.
+    static TiffImage load_window(const std::string &path, const PixelWindow &window,
+                                 unsigned int cores, ThreadPool &pool = ThreadPool::instance());
+    static TiffImage load_window(const TiffBuffer &buffer, const PixelWindow &window,
+                                 unsigned int cores, ThreadPool &pool = ThreadPool::instance());
+  };
+
+  // Reads an 8-bit single band TIFF file a few rows at a time through one libtiff handle. Only
+  // the strip, or the row of tiles, the last rows came from stays decoded, so reading a band
+  // from top to bottom decodes every block once and holds one at a time.
+  class TiffStripReader {
+  private:
+    tiff *tiff_ = nullptr;
+    std::string path_;
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    bool tiled_ = false;
+    unsigned int block_width_ = 0;
+    unsigned int block_height_ = 0;
+    std::vector<unsigned char> block_rows_;
+    long decoded_block_row_ = -1;
+
+    bool decode_block_row(unsigned int block_row);
+
+  public:
+    // Leaves the reader closed, after a warning for layouts it cannot read, on failure.
+    explicit TiffStripReader(const std::string &path);
+    TiffStripReader(const TiffStripReader &) = delete;
+    TiffStripReader &operator=(const TiffStripReader &) = delete;
+    ~TiffStripReader();
+
+    bool is_open() const;
+    unsigned int width() const;
+    unsigned int height() const;
+    // Rows of one strip, or of one row of tiles, of the band.
+    unsigned int rows_per_strip() const;
+
+    // Replaces the destination with the rows. Returns false, after a warning, when they lie
+    // outside of the band or cannot be decoded.
+    bool read_rows(unsigned int row, unsigned int rows, TiffImage &destination);
+  };
+}
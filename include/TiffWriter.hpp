@@ -0,0 +1,84 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "GeoReference.hpp"
+#include "WaterCohererTypes.hpp"
+#include <string>
+#include <vector>
+
+struct tiff;
+
+namespace WaterCoherer {
+  // Writes a mask of known size one bit per pixel as a strip TIFF file while its rows arrive, so
+  // the mask never has to be held in memory. Rows that do not fill a strip wait for the next
+  // call; the strips of a call are compressed in parallel. A file that did not receive all of
+  // its rows is removed when closed. Whole layers are written by CogWriter.
+  class TiffStripWriter {
+  public:
+    enum class Compression {
+      Uncompressed,
+      Deflate
+    };
+
+    // Uncompressed strips hold about this many bytes; compressed ones are built from as many.
+    static constexpr unsigned int strip_bytes = 64 * 1024;
+
+  private:
+    tiff *tiff_ = nullptr;
+    std::string path_;
+    unsigned int width_;
+    unsigned int height_;
+    Compression compression_;
+    unsigned int row_bytes_ = 0;
+    unsigned int rows_per_strip_ = 1;
+    unsigned int next_strip_ = 0;
+    unsigned int rows_received_ = 0;
+    // Rows as they are stored in the file.
+    std::vector<unsigned char> pending_;
+    unsigned int pending_rows_ = 0;
+    bool failed_ = false;
+
+    bool write_strips(const unsigned char *rows, unsigned int strip_count,
+                      unsigned int strip_rows, unsigned int cores);
+    bool write_packed_rows(const unsigned char *rows, unsigned int count, unsigned int cores);
+
+  public:
+    TiffStripWriter(const std::string &path, unsigned int width, unsigned int height,
+                    const GeoReference &georeference = GeoReference(),
+                    Compression compression = Compression::Deflate);
+    TiffStripWriter(const TiffStripWriter &) = delete;
+    TiffStripWriter &operator=(const TiffStripWriter &) = delete;
+    ~TiffStripWriter();
+
+    bool is_open() const;
+    unsigned int rows_per_strip() const;
+
+    // Appends the next rows of the mask. Returns false, after a warning, when they do not
+    // match the mask's size or cannot be written; the file is then removed by close().
+    bool write_rows(const PixelMask &rows, unsigned int cores);
+
+    // Returns false when the file is incomplete or could not be written.
+    bool close();
+  };
+}
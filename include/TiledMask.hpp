@@ -0,0 +1,104 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "PixelMask.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace WaterCoherer {
+  // Binary raster mask split into square tiles of tile_size pixels. Tiles that are entirely unset
+  // or entirely set are marked by their state, so kernels and writers can handle them without
+  // touching single pixels. Rows of a mixed tile are stored as one word each, in one buffer that
+  // holds the rows of all tiles tile after tile; no tile allocates memory of its own, and the
+  // words of empty and full tiles are never looked at.
+  class TiledMask {
+  public:
+    using Word = PixelMask::Word;
+    static constexpr unsigned int tile_size = PixelMask::word_bits;
+
+    enum class TileState : unsigned char {
+      Empty,
+      Full,
+      Mixed
+    };
+
+  private:
+    unsigned int width_ = 0;
+    unsigned int height_ = 0;
+    unsigned int tiles_x_ = 0;
+    unsigned int tiles_y_ = 0;
+    std::vector<TileState> states_;
+    std::vector<Word> words_;
+
+    std::size_t tile_index(unsigned int tile_x, unsigned int tile_y) const {
+      return static_cast<std::size_t>(tile_y) * tiles_x_ + tile_x;
+    }
+
+    Word *rows(std::size_t index) {
+      return words_.data() + index * tile_size;
+    }
+
+    const Word *rows(std::size_t index) const {
+      return words_.data() + index * tile_size;
+    }
+
+  public:
+    TiledMask() = default;
+    TiledMask(unsigned int width, unsigned int height);
+
+    static TiledMask from_pixel_mask(const PixelMask &);
+
+    PixelMask to_pixel_mask() const;
+
+    unsigned int width() const;
+    unsigned int height() const;
+    unsigned int tiles_x() const;
+    unsigned int tiles_y() const;
+    bool same_size(const TiledMask &) const;
+
+    // Bits of tile_width(tile_x) pixels starting at the tile's left edge.
+    Word valid_bits(unsigned int tile_x) const;
+    unsigned int tile_width(unsigned int tile_x) const;
+    unsigned int tile_height(unsigned int tile_y) const;
+
+    TileState tile_state(unsigned int tile_x, unsigned int tile_y) const {
+      return states_[tile_index(tile_x, tile_y)];
+    }
+
+    // Row words of a mixed tile, nullptr for empty and full tiles.
+    const Word *tile_rows(unsigned int tile_x, unsigned int tile_y) const;
+
+    // Stores tile_height(tile_y) row words and derives the tile state from them. Different tiles
+    // may be stored concurrently.
+    void store_tile(unsigned int tile_x, unsigned int tile_y, const Word *words);
+
+    void fill_tile(unsigned int tile_x, unsigned int tile_y, TileState state);
+
+    bool test(unsigned int x, unsigned int y) const;
+
+    std::size_t count() const;
+
+    TiledMask &operator|=(const TiledMask &);
+  };
+}
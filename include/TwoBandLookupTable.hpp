@@ -0,0 +1,68 @@
+#pragma once
+
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "PixelMask.hpp"
+#include <vector>
+
+namespace WaterCoherer {
+  // Precomputed classification of every pair of 8-bit values from two bands. Classifying a pixel
+  // costs a single table lookup, whatever index and threshold the table was built for.
+  class TwoBandLookupTable {
+  public:
+    static constexpr unsigned int size = 256 * 256;
+
+  private:
+    // Padded so vector gathers may read a whole 32-bit word at the last entry.
+    std::vector<unsigned char> table_ = std::vector<unsigned char>(size + 3, 0);
+
+  public:
+    TwoBandLookupTable() = default;
+
+    template<typename Classifier>
+    static TwoBandLookupTable build(Classifier classifier) {
+      TwoBandLookupTable result;
+      for (unsigned int first = 0; first < 256; ++first) {
+        for (unsigned int second = 0; second < 256; ++second) {
+          bool positive = classifier(static_cast<unsigned char>(first),
+                                     static_cast<unsigned char>(second));
+          result.table_[first << 8 | second] = positive ? 1 : 0;
+        }
+      }
+      return result;
+    }
+
+    // (first - second) / (first + second) compared with the threshold, for pixels whose values
+    // in both bands are above 1. Inclusive tables also accept indices equal to the threshold.
+    static TwoBandLookupTable normalized_difference(float threshold, bool inclusive);
+
+    bool classify(unsigned char first, unsigned char second) const {
+      return table_[first << 8 | second];
+    }
+
+    const unsigned char *data() const;
+
+    void classify_row(const unsigned char *first, const unsigned char *second, unsigned int width,
+                      PixelMask::Word *words) const;
+  };
+}
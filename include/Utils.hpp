@@ -22,14 +22,22 @@
 //  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 //  DEALINGS IN THE SOFTWARE.
 
+#include "RunLengthMask.hpp"
+#include "TiledMask.hpp"
 #include "WaterCohererTypes.hpp"
 #include <map>
 #include <vector>
 
 namespace WaterCoherer {
-  PixelPositions merge_pixel_positions_layers(PixelPositionsLayers &);
+  PixelMask merge_pixel_positions_layers(const PixelPositionsLayers &, unsigned int);
+
+  RunLengthMask merge_pixel_positions_layers(const RunLengthMaskLayers &);
 
   std::vector<std::string> split(const std::string &, char);
 
-  TiffImage generate_layer(const PixelPositions &pixel_positions, int width, int height);
+  TiffImage generate_layer(const PixelMask &pixel_mask);
+
+  TiffImage generate_layer(const RunLengthMask &run_length_mask);
+
+  TiffImage generate_layer(const TiledMask &tiled_mask);
 }
@@ -23,13 +23,12 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "CImage.hpp"
+#include "PixelMask.hpp"
 #include <map>
-#include <set>
 #include <string>
 
 namespace WaterCoherer {
   using TiffImage = cimg_library::CImg<unsigned char>;
   using ImageLayers = std::map<std::string,TiffImage>;
-  using PixelPositions = std::set<std::pair<unsigned int, unsigned int>>;
-  using PixelPositionsLayers = std::map<std::string, PixelPositions>;
+  using PixelPositionsLayers = std::map<std::string, PixelMask>;
 }
\ No newline at end of file
@@ -31,11 +31,15 @@ namespace WaterCoherer {
 
   class WaterDifferencer {
   private:
-    PixelPositions water_localization_;
+    PixelMask water_localization_;
 
   public:
-    explicit WaterDifferencer(PixelPositions);
+    explicit WaterDifferencer(PixelMask);
 
     TiffImage generate_clasterized_water_layer(const TiffImage&);
+
+    // Same layer built from the bright water mask of a SceneClassification, without reading the
+    // near infrared band again.
+    TiffImage generate_clasterized_water_layer(const PixelMask&);
   };
 }  // namespace WaterCoherer
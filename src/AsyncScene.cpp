@@ -0,0 +1,84 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "AsyncScene.hpp"
+#include "CloudDetection.hpp"
+#include "CogWriter.hpp"
+#include "NDWICalculator.hpp"
+#include "ResourceGovernor.hpp"
+
+#include <utility>
+
+using namespace WaterCoherer;
+
+ThreadPool &AsyncScene::io_pool() {
+  // A few threads keep a fast disk busy; more would only compete for it.
+  static ThreadPool pool(4);
+  return pool;
+}
+
+AsyncTask<AsyncScene::Scene> AsyncScene::load_scene(std::string directory) {
+  SceneSlots &slots = ResourceGovernor::instance().scene_slots();
+  co_await slots.acquire_async();
+  // The slot is returned with the last reference to the scene.
+  Scene scene(new LandsatImage(), [&slots](LandsatImage *image) {
+    delete image;
+    slots.release();
+  });
+  co_await resume_on(io_pool());
+  // The bands the stages view are read and decoded on the I/O pool, so no stage blocks the
+  // shared pool on the disk.
+  scene->load_image(directory.c_str());
+  scene->prefetch({LandsatImage::Band::Blue, LandsatImage::Band::Green,
+                   LandsatImage::Band::NearInfrared}, io_pool());
+  co_return scene;
+}
+
+AsyncTask<PixelMask> AsyncScene::detect_clouds(Scene scene, unsigned int cores) {
+  co_await resume_on(ThreadPool::instance());
+  co_return CloudDetection::localize_clouds(scene->view_blue_layer(), cores);
+}
+
+AsyncTask<PixelMask> AsyncScene::localize_water(Scene scene, unsigned int cores) {
+  co_await resume_on(ThreadPool::instance());
+  co_return NDWICalculator::localize_water(cores, scene->view_green_layer(),
+                                           scene->view_nir_layer(),
+                                           NDWICalculator::lookup_table(
+                                             NDWICalculator::Method::GreenNir));
+}
+
+AsyncTask<PixelMask> AsyncScene::localize_water(Scene scene, unsigned int cores,
+                                                PixelMask omitted_pixels) {
+  co_await resume_on(ThreadPool::instance());
+  co_return NDWICalculator::localize_water(cores, scene->view_green_layer(),
+                                           scene->view_nir_layer(), omitted_pixels);
+}
+
+AsyncTask<bool> AsyncScene::write_layer(TiffImage layer, std::string path) {
+  co_await resume_on(io_pool());
+  co_return CogWriter::save(layer, path, ThreadPool::instance().size());
+}
+
+AsyncTask<bool> AsyncScene::write_layer(PixelMask mask, std::string path) {
+  co_await resume_on(io_pool());
+  co_return CogWriter::save(mask, path, ThreadPool::instance().size());
+}
@@ -21,42 +21,46 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "CloudDetection.hpp"
-
-#include <mutex>
-#include <thread>
+#include "RasterKernels.hpp"
+#include "RasterPartitioner.hpp"
 
 using namespace WaterCoherer;
 
-PixelPositions CloudDetection::localize_clouds(const WaterCoherer::TiffImage &image_layer,
-                                                       unsigned int cores) {
-  PixelPositions result;
-  std::vector<std::thread> thread_pool;
-  std::mutex result_mutex;
-  for (unsigned int i = 0UL; i < cores; ++i) {
-    thread_pool.emplace_back(
-      std::thread([i, cores, &result, &image_layer, &result_mutex]() {
-        unsigned int height = image_layer.height() / cores;
-        unsigned int start = i > 0 ? height * i : height * i + 1;
-        unsigned int stop = i < cores - 1 ? height * (i + 1) + 1 : (height * (i + 1));
-
-        for (unsigned int y = start; y < stop - 1; ++y) {
-          for (unsigned int x = 0; x < static_cast<unsigned int>(image_layer.width()); ++x) {
-            float value = image_layer(x, y);
-            if(value < 1.f )
-            {
-              continue;
-            }
-            if (value > 120.f) {
-              std::lock_guard<std::mutex> guard(result_mutex);
-              result.insert({x, y});
-            }
-          }
-        }
-      }));
-  }
+PixelMask CloudDetection::localize_clouds(const WaterCoherer::TiffImage &image_layer,
+                                          unsigned int cores) {
+  PixelMask result(image_layer.width(), image_layer.height());
+  RasterPartitioner partitioner(result.width(), result.height());
+  partitioner.run(cores, [&result, &image_layer](const RasterTile &tile) {
+    // Tiles never share mask words, so they are classified straight into the result without
+    // any synchronisation. Nodata pixels are below the threshold.
+    for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+      RasterKernels::threshold_above(image_layer.data(tile.x_begin, y), tile.width(), 120,
+                                     result.row(y) + tile.x_begin / PixelMask::word_bits);
+    }
+  });
+  return result;
+}
 
-  for (auto &&thread : thread_pool) {
-    thread.join();
-  }
+TiledMask CloudDetection::localize_clouds_tiled(const WaterCoherer::TiffImage &image_layer,
+                                                unsigned int cores) {
+  TiledMask result(image_layer.width(), image_layer.height());
+  RasterPartitioner partitioner(result.width(), result.height(),
+                                RasterPartitioner::default_tile_width, TiledMask::tile_size);
+  partitioner.run(cores, [&result, &image_layer](const RasterTile &tile) {
+    // Tiles are classified into a local buffer; storing them derives the empty, full or
+    // mixed state on the way.
+    TiledMask::Word rows[TiledMask::tile_size];
+    unsigned int tile_y = tile.y_begin / TiledMask::tile_size;
+    unsigned int y_begin = tile.y_begin;
+    for (unsigned int tile_x = tile.x_begin / TiledMask::tile_size;
+         tile_x * TiledMask::tile_size < tile.x_end; ++tile_x) {
+      unsigned int x_begin = tile_x * TiledMask::tile_size;
+      for (unsigned int y = 0; y < result.tile_height(tile_y); ++y) {
+        RasterKernels::threshold_above(image_layer.data(x_begin, y_begin + y),
+                                       result.tile_width(tile_x), 120, rows + y);
+      }
+      result.store_tile(tile_x, tile_y, rows);
+    }
+  });
   return result;
-}
\ No newline at end of file
+}
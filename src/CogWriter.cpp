@@ -0,0 +1,457 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "CogWriter.hpp"
+#include "RasterPartitioner.hpp"
+#include "ThreadPool.hpp"
+#include "TiffCompression.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace WaterCoherer;
+
+namespace {
+  enum TagType : uint16_t {
+    ascii_type = 2,
+    short_type = 3,
+    long_type = 4,
+    double_type = 12,
+    long8_type = 16
+  };
+
+  struct TagEntry {
+    uint16_t tag;
+    uint16_t type;
+    uint64_t count;
+    // Little endian value bytes.
+    std::vector<unsigned char> value;
+  };
+
+  // A level holds either an 8-bit layer or a bilevel mask.
+  struct Level {
+    const TiffImage *image;
+    const PixelMask *mask;
+    unsigned int width;
+    unsigned int height;
+    unsigned int tiles_x;
+    unsigned int tiles_y;
+    std::vector<std::vector<unsigned char>> tiles;
+    std::vector<uint64_t> offsets;
+  };
+
+  void put(std::vector<unsigned char> &bytes, uint64_t value, unsigned int size) {
+    for (unsigned int i = 0; i < size; ++i) {
+      bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+  }
+
+  template<typename T>
+  TagEntry entry(uint16_t tag, uint16_t type, unsigned int size, const std::vector<T> &values) {
+    TagEntry result{tag, type, values.size(), {}};
+    for (const auto &value : values) {
+      uint64_t bits = 0;
+      if constexpr (std::is_floating_point_v<T>) {
+        std::memcpy(&bits, &value, sizeof(double));
+      } else {
+        bits = static_cast<uint64_t>(value);
+      }
+      put(result.value, bits, size);
+    }
+    return result;
+  }
+
+  TagEntry short_entry(uint16_t tag, const std::vector<uint16_t> &values) {
+    return entry(tag, short_type, 2, values);
+  }
+
+  TagEntry long_entry(uint16_t tag, const std::vector<uint32_t> &values) {
+    return entry(tag, long_type, 4, values);
+  }
+
+  // Offsets and byte counts of tiles, which BigTIFF stores in 64 bits.
+  TagEntry offset_entry(uint16_t tag, const std::vector<uint64_t> &values, bool big_tiff) {
+    return big_tiff ? entry(tag, long8_type, 8, values) : entry(tag, long_type, 4, values);
+  }
+
+  std::vector<TagEntry> directory_entries(const Level &level, uint16_t compression, bool overview,
+                                          const GeoReference &georeference, bool big_tiff) {
+    unsigned int samples = level.mask ? 1 : static_cast<unsigned int>(level.image->spectrum());
+    std::vector<uint64_t> byte_counts;
+    for (const auto &tile : level.tiles) {
+      byte_counts.push_back(tile.size());
+    }
+    std::vector<uint64_t> offsets = level.offsets;
+    offsets.resize(level.tiles.size(), 0);
+
+    // Entries are sorted by tag, as TIFF requires.
+    std::vector<TagEntry> entries;
+    entries.push_back(long_entry(254, {overview ? 1U : 0U}));
+    entries.push_back(long_entry(256, {level.width}));
+    entries.push_back(long_entry(257, {level.height}));
+    entries.push_back(short_entry(258, std::vector<uint16_t>(samples, level.mask ? 1 : 8)));
+    entries.push_back(short_entry(259, {compression}));
+    entries.push_back(short_entry(262, {static_cast<uint16_t>(samples == 3 ? 2 : 1)}));
+    entries.push_back(short_entry(277, {static_cast<uint16_t>(samples)}));
+    entries.push_back(short_entry(284, {1}));
+    entries.push_back(short_entry(322, {CogWriter::tile_size}));
+    entries.push_back(short_entry(323, {CogWriter::tile_size}));
+    entries.push_back(offset_entry(324, offsets, big_tiff));
+    entries.push_back(offset_entry(325, byte_counts, big_tiff));
+    entries.push_back(short_entry(339, std::vector<uint16_t>(samples, 1)));
+
+    // Readers take the georeference of overviews from the full resolution image.
+    if (!overview && georeference.valid()) {
+      entries.push_back(entry(GeoReference::model_pixel_scale_tag, double_type, 8,
+                              std::vector<double>{georeference.pixel_width(),
+                                                  georeference.pixel_height(), 0.}));
+      entries.push_back(entry(GeoReference::model_tiepoint_tag, double_type, 8,
+                              std::vector<double>{0., 0., 0., georeference.origin_x(),
+                                                  georeference.origin_y(), 0.}));
+      if (!georeference.geo_keys().empty()) {
+        entries.push_back(short_entry(GeoReference::geo_key_directory_tag,
+                                      georeference.geo_keys()));
+      }
+      if (!georeference.geo_doubles().empty()) {
+        entries.push_back(entry(GeoReference::geo_double_params_tag, double_type, 8,
+                                georeference.geo_doubles()));
+      }
+      if (!georeference.geo_ascii().empty()) {
+        TagEntry ascii{GeoReference::geo_ascii_params_tag, ascii_type, 0,
+                       std::vector<unsigned char>(georeference.geo_ascii().begin(),
+                                                  georeference.geo_ascii().end())};
+        ascii.value.push_back(0);
+        ascii.count = ascii.value.size();
+        entries.push_back(std::move(ascii));
+      }
+    }
+    return entries;
+  }
+
+  // Bytes of a directory including the values that do not fit into its entries.
+  uint64_t directory_size(const std::vector<TagEntry> &entries, bool big_tiff) {
+    unsigned int inline_size = big_tiff ? 8 : 4;
+    uint64_t size = (big_tiff ? 8 : 2) + entries.size() * (big_tiff ? 20 : 12) +
+                    (big_tiff ? 8 : 4);
+    for (const auto &entry : entries) {
+      if (entry.value.size() > inline_size) {
+        size += (entry.value.size() + 1) & ~uint64_t(1);
+      }
+    }
+    return size;
+  }
+
+  void put_directory(std::vector<unsigned char> &bytes, const std::vector<TagEntry> &entries,
+                     uint64_t offset, uint64_t next_offset, bool big_tiff) {
+    unsigned int inline_size = big_tiff ? 8 : 4;
+    put(bytes, entries.size(), big_tiff ? 8 : 2);
+    uint64_t value_offset = offset + (big_tiff ? 8 : 2) + entries.size() * (big_tiff ? 20 : 12) +
+                            (big_tiff ? 8 : 4);
+    std::vector<unsigned char> values;
+    for (const auto &entry : entries) {
+      put(bytes, entry.tag, 2);
+      put(bytes, entry.type, 2);
+      put(bytes, entry.count, big_tiff ? 8 : 4);
+      if (entry.value.size() <= inline_size) {
+        bytes.insert(bytes.end(), entry.value.begin(), entry.value.end());
+        bytes.resize(bytes.size() + inline_size - entry.value.size(), 0);
+        continue;
+      }
+      put(bytes, value_offset + values.size(), inline_size);
+      values.insert(values.end(), entry.value.begin(), entry.value.end());
+      values.resize((values.size() + 1) & ~std::size_t(1), 0);
+    }
+    put(bytes, next_offset, big_tiff ? 8 : 4);
+    bytes.insert(bytes.end(), values.begin(), values.end());
+  }
+
+  TiffImage halve(const TiffImage &image, unsigned int cores) {
+    TiffImage result((image.width() + 1) / 2, (image.height() + 1) / 2, 1, image.spectrum());
+    RasterPartitioner partitioner(result.width(), result.height());
+    partitioner.run(cores, [&result, &image](const RasterTile &tile) {
+      for (int c = 0; c < result.spectrum(); ++c) {
+        for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+          const unsigned char *source = image.data(0, 2 * y, 0, c);
+          unsigned char *destination = result.data(0, y, 0, c);
+          for (unsigned int x = tile.x_begin; x < tile.x_end; ++x) {
+            destination[x] = source[2 * x];
+          }
+        }
+      }
+    });
+    return result;
+  }
+
+  // Keeps the even bits of a word in its lower half.
+  PixelMask::Word even_bits(PixelMask::Word word) {
+    word &= 0x5555555555555555ULL;
+    word = (word | (word >> 1)) & 0x3333333333333333ULL;
+    word = (word | (word >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+    word = (word | (word >> 4)) & 0x00FF00FF00FF00FFULL;
+    word = (word | (word >> 8)) & 0x0000FFFF0000FFFFULL;
+    word = (word | (word >> 16)) & 0x00000000FFFFFFFFULL;
+    return word;
+  }
+
+  PixelMask halve(const PixelMask &mask, unsigned int cores) {
+    PixelMask result((mask.width() + 1) / 2, (mask.height() + 1) / 2);
+    RasterPartitioner partitioner(result.width(), result.height());
+    partitioner.run(cores, [&result, &mask](const RasterTile &tile) {
+      std::size_t word_end = PixelMask::words_for_width(tile.x_end);
+      for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+        const PixelMask::Word *source = mask.row(2 * y);
+        PixelMask::Word *destination = result.row(y);
+        for (std::size_t i = tile.x_begin / PixelMask::word_bits; i < word_end; ++i) {
+          PixelMask::Word high = 2 * i + 1 < mask.words_per_row() ? source[2 * i + 1] : 0;
+          destination[i] = even_bits(source[2 * i]) | (even_bits(high) << 32);
+        }
+      }
+    });
+    return result;
+  }
+
+  bool compress(const std::vector<unsigned char> &pixels, CogWriter::Compression compression,
+                std::vector<unsigned char> &bytes) {
+    switch (compression) {
+      case CogWriter::Compression::Lzw:
+        TiffCompression::lzw(pixels.data(), pixels.size(), bytes);
+        return true;
+      case CogWriter::Compression::Zstd:
+        return TiffCompression::zstd(pixels.data(), pixels.size(), bytes);
+      default:
+        return TiffCompression::deflate(pixels.data(), pixels.size(), bytes);
+    }
+  }
+
+  // Interleaves the channels of the tile, or packs its bits, pads it to full size and
+  // compresses it.
+  bool encode_tile(const Level &level, unsigned int tile_x, unsigned int tile_y,
+                   CogWriter::Compression compression, std::vector<unsigned char> &bytes) {
+    constexpr unsigned int tile_size = CogWriter::tile_size;
+    unsigned int x_begin = tile_x * tile_size;
+    unsigned int y_begin = tile_y * tile_size;
+    unsigned int width = std::min(tile_size, level.width - x_begin);
+    unsigned int height = std::min(tile_size, level.height - y_begin);
+    if (level.mask) {
+      std::vector<unsigned char> pixels(static_cast<std::size_t>(tile_size) * tile_size / 8, 0);
+      for (unsigned int y = 0; y < height; ++y) {
+        level.mask->pack_msb_first(y_begin + y, x_begin, width,
+                                   pixels.data() + static_cast<std::size_t>(y) * tile_size / 8);
+      }
+      return compress(pixels, compression, bytes);
+    }
+
+    const TiffImage &image = *level.image;
+    auto samples = static_cast<unsigned int>(image.spectrum());
+    std::vector<unsigned char> pixels(static_cast<std::size_t>(tile_size) * tile_size * samples, 0);
+    for (unsigned int y = 0; y < height; ++y) {
+      unsigned char *destination =
+        pixels.data() + static_cast<std::size_t>(y) * tile_size * samples;
+      for (unsigned int c = 0; c < samples; ++c) {
+        const unsigned char *source = image.data(x_begin, y_begin + y, 0, c);
+        for (unsigned int x = 0; x < width; ++x) {
+          destination[x * samples + c] = source[x];
+        }
+      }
+    }
+    return compress(pixels, compression, bytes);
+  }
+
+  uint16_t compression_tag(CogWriter::Compression compression) {
+    switch (compression) {
+      case CogWriter::Compression::Lzw:
+        return TiffCompression::lzw_tag;
+      case CogWriter::Compression::Zstd:
+        return TiffCompression::zstd_tag;
+      default:
+        return TiffCompression::deflate_tag;
+    }
+  }
+
+  bool write_levels(std::vector<Level> &levels, const std::string &path, unsigned int cores,
+                    const GeoReference &georeference, CogWriter::Compression compression) {
+    constexpr unsigned int tile_size = CogWriter::tile_size;
+    if (compression == CogWriter::Compression::Zstd && !TiffCompression::zstd_available()) {
+      std::cerr << "WARNING WaterCoherer: ZSTD is not built in, writing DEFLATE instead:\n" <<
+                "\t" + path << std::endl;
+      compression = CogWriter::Compression::Deflate;
+    }
+
+    std::vector<std::pair<std::size_t, unsigned int>> tiles;
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+      auto &level = levels[i];
+      level.tiles_x = (level.width + tile_size - 1) / tile_size;
+      level.tiles_y = (level.height + tile_size - 1) / tile_size;
+      level.tiles.resize(static_cast<std::size_t>(level.tiles_x) * level.tiles_y);
+      for (unsigned int tile = 0; tile < level.tiles.size(); ++tile) {
+        tiles.emplace_back(i, tile);
+      }
+    }
+
+    // Tiles of all levels are compressed in one pass.
+    std::atomic<std::size_t> next_tile{0};
+    std::atomic<bool> failed{false};
+    unsigned int workers = static_cast<unsigned int>(
+      std::min<std::size_t>(std::max(cores, 1u), tiles.size()));
+    ThreadPool::instance().parallel_for(workers, [&levels, &tiles, &next_tile, &failed,
+                                                  compression](unsigned int) {
+      std::size_t index;
+      while (!failed && (index = next_tile++) < tiles.size()) {
+        auto &level = levels[tiles[index].first];
+        unsigned int tile = tiles[index].second;
+        if (!encode_tile(level, tile % level.tiles_x, tile / level.tiles_x, compression,
+                         level.tiles[tile])) {
+          failed = true;
+        }
+      }
+    });
+    if (failed) {
+      std::cerr << "WARNING WaterCoherer: Could not compress output file:\n" << "\t" + path
+                << std::endl;
+      return false;
+    }
+
+    // Directories come first, then the tile data of the levels from the smallest overview up.
+    uint16_t compression_value = compression_tag(compression);
+    uint64_t data_size = 0;
+    for (const auto &level : levels) {
+      for (const auto &tile : level.tiles) {
+        data_size += tile.size();
+      }
+    }
+    bool big_tiff = false;
+    uint64_t data_offset = 0;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      data_offset = big_tiff ? 16 : 8;
+      for (std::size_t i = 0; i < levels.size(); ++i) {
+        data_offset += directory_size(directory_entries(levels[i], compression_value, i > 0,
+                                                        georeference, big_tiff), big_tiff);
+      }
+      if (big_tiff || data_offset + data_size <= UINT32_MAX) {
+        break;
+      }
+      big_tiff = true;
+    }
+
+    uint64_t offset = data_offset;
+    for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+      for (const auto &tile : level->tiles) {
+        level->offsets.push_back(offset);
+        offset += tile.size();
+      }
+    }
+
+    std::vector<unsigned char> header;
+    header.push_back('I');
+    header.push_back('I');
+    if (big_tiff) {
+      put(header, 43, 2);
+      put(header, 8, 2);
+      put(header, 0, 2);
+      put(header, 16, 8);
+    } else {
+      put(header, 42, 2);
+      put(header, 8, 4);
+    }
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+      auto entries = directory_entries(levels[i], compression_value, i > 0, georeference,
+                                       big_tiff);
+      uint64_t directory_offset = header.size();
+      uint64_t next_offset = i + 1 < levels.size() ?
+                             directory_offset + directory_size(entries, big_tiff) : 0;
+      put_directory(header, entries, directory_offset, next_offset, big_tiff);
+    }
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (nullptr == file) {
+      std::cerr << "WARNING WaterCoherer: Could not open output file:\n" << "\t" + path
+                << std::endl;
+      return false;
+    }
+    bool written = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+    for (auto level = levels.rbegin(); level != levels.rend() && written; ++level) {
+      for (const auto &tile : level->tiles) {
+        if (std::fwrite(tile.data(), 1, tile.size(), file) != tile.size()) {
+          written = false;
+          break;
+        }
+      }
+    }
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+      std::remove(path.c_str());
+      std::cerr << "WARNING WaterCoherer: Could not write output file:\n" << "\t" + path
+                << std::endl;
+      return false;
+    }
+    return true;
+  }
+}
+
+bool CogWriter::save(const TiffImage &layer, const std::string &path, unsigned int cores,
+                     const GeoReference &georeference, Compression compression) {
+  if (layer.is_empty() || layer.depth() != 1 || (layer.spectrum() != 1 && layer.spectrum() != 3)) {
+    std::cerr << "WARNING WaterCoherer: Layer cannot be written as TIFF:\n" << "\t" + path
+              << std::endl;
+    return false;
+  }
+
+  // Overviews halve the previous level until it fits into one tile.
+  std::vector<std::unique_ptr<TiffImage>> overviews;
+  std::vector<Level> levels;
+  levels.push_back({&layer, nullptr, static_cast<unsigned int>(layer.width()),
+                    static_cast<unsigned int>(layer.height()), 0, 0, {}, {}});
+  while (levels.back().width > tile_size || levels.back().height > tile_size) {
+    overviews.emplace_back(new TiffImage(halve(*levels.back().image, cores)));
+    levels.push_back({overviews.back().get(), nullptr,
+                      static_cast<unsigned int>(overviews.back()->width()),
+                      static_cast<unsigned int>(overviews.back()->height()), 0, 0, {}, {}});
+  }
+  return write_levels(levels, path, cores, georeference, compression);
+}
+
+bool CogWriter::save(const PixelMask &mask, const std::string &path, unsigned int cores,
+                     const GeoReference &georeference, Compression compression) {
+  if (0 == mask.width() || 0 == mask.height()) {
+    std::cerr << "WARNING WaterCoherer: Layer cannot be written as TIFF:\n" << "\t" + path
+              << std::endl;
+    return false;
+  }
+
+  std::vector<std::unique_ptr<PixelMask>> overviews;
+  std::vector<Level> levels;
+  levels.push_back({nullptr, &mask, mask.width(), mask.height(), 0, 0, {}, {}});
+  while (levels.back().width > tile_size || levels.back().height > tile_size) {
+    overviews.emplace_back(new PixelMask(halve(*levels.back().mask, cores)));
+    levels.push_back({nullptr, overviews.back().get(), overviews.back()->width(),
+                      overviews.back()->height(), 0, 0, {}, {}});
+  }
+  return write_levels(levels, path, cores, georeference, compression);
+}
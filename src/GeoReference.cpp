@@ -0,0 +1,179 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "GeoReference.hpp"
+#include "TiffBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  TIFFExtendProc parent_extender = nullptr;
+
+  char model_pixel_scale_name[] = "ModelPixelScaleTag";
+  char model_tiepoint_name[] = "ModelTiepointTag";
+  char geo_key_directory_name[] = "GeoKeyDirectoryTag";
+  char geo_double_params_name[] = "GeoDoubleParamsTag";
+  char geo_ascii_params_name[] = "GeoASCIIParamsTag";
+
+  const TIFFFieldInfo geotiff_fields[] = {
+    {GeoReference::model_pixel_scale_tag, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_DOUBLE,
+     FIELD_CUSTOM, 1, 1, model_pixel_scale_name},
+    {GeoReference::model_tiepoint_tag, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_DOUBLE, FIELD_CUSTOM,
+     1, 1, model_tiepoint_name},
+    {GeoReference::geo_key_directory_tag, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_SHORT,
+     FIELD_CUSTOM, 1, 1, geo_key_directory_name},
+    {GeoReference::geo_double_params_tag, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_DOUBLE,
+     FIELD_CUSTOM, 1, 1, geo_double_params_name},
+    {GeoReference::geo_ascii_params_tag, TIFF_VARIABLE, TIFF_VARIABLE, TIFF_ASCII, FIELD_CUSTOM,
+     1, 0, geo_ascii_params_name}
+  };
+
+  void extend_tags(TIFF *tiff) {
+    TIFFMergeFieldInfo(tiff, geotiff_fields, sizeof(geotiff_fields) / sizeof(geotiff_fields[0]));
+    if (parent_extender) {
+      parent_extender(tiff);
+    }
+  }
+
+  template<typename T>
+  std::vector<T> read_array(TIFF *tiff, uint32_t tag) {
+    uint16_t count = 0;
+    T *values = nullptr;
+    if (!TIFFGetField(tiff, tag, &count, &values) || nullptr == values) {
+      return std::vector<T>();
+    }
+    return std::vector<T>(values, values + count);
+  }
+}
+
+void GeoReference::register_tags() {
+  static std::once_flag registered;
+  std::call_once(registered, []() { parent_extender = TIFFSetTagExtender(extend_tags); });
+}
+
+GeoReference GeoReference::read(const std::string &path) {
+  register_tags();
+  return read(TIFFOpen(path.c_str(), "r"));
+}
+
+GeoReference GeoReference::read(const TiffBuffer &buffer) {
+  return read(buffer.open());
+}
+
+GeoReference GeoReference::read(TIFF *tiff) {
+  GeoReference result;
+  if (nullptr == tiff) {
+    return result;
+  }
+
+  auto scale = read_array<double>(tiff, model_pixel_scale_tag);
+  auto tiepoint = read_array<double>(tiff, model_tiepoint_tag);
+  result.geo_keys_ = read_array<uint16_t>(tiff, geo_key_directory_tag);
+  result.geo_doubles_ = read_array<double>(tiff, geo_double_params_tag);
+  char *ascii = nullptr;
+  if (TIFFGetField(tiff, geo_ascii_params_tag, &ascii) && nullptr != ascii) {
+    result.geo_ascii_ = ascii;
+  }
+  TIFFClose(tiff);
+
+  // Tie point (i, j, k, x, y, z) places raster position (i, j) at map position (x, y).
+  if (scale.size() >= 2 && tiepoint.size() >= 6 && scale[0] > 0. && scale[1] > 0.) {
+    result.pixel_width_ = scale[0];
+    result.pixel_height_ = scale[1];
+    result.origin_x_ = tiepoint[3] - tiepoint[0] * scale[0];
+    result.origin_y_ = tiepoint[4] + tiepoint[1] * scale[1];
+    result.valid_ = true;
+  }
+  return result;
+}
+
+bool GeoReference::valid() const {
+  return valid_;
+}
+
+double GeoReference::pixel_width() const {
+  return pixel_width_;
+}
+
+double GeoReference::pixel_height() const {
+  return pixel_height_;
+}
+
+double GeoReference::origin_x() const {
+  return origin_x_;
+}
+
+double GeoReference::origin_y() const {
+  return origin_y_;
+}
+
+const std::vector<uint16_t> &GeoReference::geo_keys() const {
+  return geo_keys_;
+}
+
+const std::vector<double> &GeoReference::geo_doubles() const {
+  return geo_doubles_;
+}
+
+const std::string &GeoReference::geo_ascii() const {
+  return geo_ascii_;
+}
+
+GeoReference GeoReference::window(const PixelWindow &window) const {
+  GeoReference result = *this;
+  result.origin_x_ += window.x * pixel_width_;
+  result.origin_y_ -= window.y * pixel_height_;
+  return result;
+}
+
+PixelWindow GeoReference::pixel_window(const MapBoundingBox &box, unsigned int width,
+                                       unsigned int height) const {
+  PixelWindow result;
+  if (!valid_) {
+    return result;
+  }
+  double left = std::floor((box.min_x - origin_x_) / pixel_width_);
+  double right = std::ceil((box.max_x - origin_x_) / pixel_width_);
+  double top = std::floor((origin_y_ - box.max_y) / pixel_height_);
+  double bottom = std::ceil((origin_y_ - box.min_y) / pixel_height_);
+  // NaN coordinates or a zero pixel size give edges that no pixel index can hold.
+  if (!std::isfinite(left) || !std::isfinite(right) || !std::isfinite(top) ||
+      !std::isfinite(bottom)) {
+    return result;
+  }
+  auto clip = [](double value, unsigned int limit) {
+    return static_cast<unsigned int>(std::min(std::max(value, 0.), static_cast<double>(limit)));
+  };
+  unsigned int x_begin = clip(left, width);
+  unsigned int x_end = clip(right, width);
+  unsigned int y_begin = clip(top, height);
+  unsigned int y_end = clip(bottom, height);
+  if (x_begin < x_end && y_begin < y_end) {
+    result = PixelWindow{x_begin, y_begin, x_end - x_begin, y_end - y_begin};
+  }
+  return result;
+}
@@ -22,110 +22,285 @@
 
 #include "CImage.hpp"
 #include "LandsatImage.hpp"
+#include "MappedTiff.hpp"
+#include "SceneArchive.hpp"
+#include "ThreadPool.hpp"
+#include "TiffReader.hpp"
 #include "Utils.hpp"
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 #include <LandsatImage.hpp>
 
 using namespace WaterCoherer;
 
 void LandsatImage::load_image(const char *input_directory_path) {
+  if (index_scene(input_directory_path)) {
+    describe_layers(nullptr);
+  }
+}
+
+void LandsatImage::load_image(const char *input_directory_path, const PixelWindow &window) {
+  if (!index_scene(input_directory_path) || image_layers_.empty()) {
+    return;
+  }
+  // All bands of a scene share one grid; a window outside of it leaves the scene without bands
+  // instead of every band decoding to an empty image.
+  unsigned int width = 0;
+  unsigned int height = 0;
+  if (!read_size(*image_layers_.begin()->second, width, height) ||
+      !window.fits_into(width, height)) {
+    std::cerr << "WARNING WaterCoherer: Window lies outside of input image:\n" << "\t" +
+              std::string(input_directory_path) << std::endl;
+    image_layers_.clear();
+    return;
+  }
+  describe_layers(&window);
+}
+
+void LandsatImage::load_image(const char *input_directory_path,
+                              const MapBoundingBox &bounding_box) {
+  if (!index_scene(input_directory_path) || image_layers_.empty()) {
+    return;
+  }
+  // All bands of a scene share one grid, so any of them places the bounding box.
+  const auto &layer = *image_layers_.begin()->second;
+  auto georeference = read_georeference(layer);
+  unsigned int width = 0;
+  unsigned int height = 0;
+  PixelWindow window;
+  if (georeference.valid() && read_size(layer, width, height)) {
+    window = georeference.pixel_window(bounding_box, width, height);
+  }
+  if (0 == window.width || 0 == window.height) {
+    std::cerr << "WARNING WaterCoherer: Bounding box does not overlap input image:\n" << "\t" +
+              std::string(input_directory_path) << std::endl;
+    image_layers_.clear();
+    return;
+  }
+  describe_layers(&window);
+}
+
+bool LandsatImage::index_scene(const char *input_path) {
+  image_descripton_ = SceneArchive::scene_name(input_path);
+  return SceneArchive::is_archive(input_path) ? read_archive_layers(input_path)
+                                              : list_layer_files(input_path);
+}
+
+bool LandsatImage::list_layer_files(const char *input_directory_path) {
   auto directory = opendir(input_directory_path);
   if (nullptr == directory) {
     std::cerr << "Could not open " << input_directory_path << " directory" << std::endl;
-    return;
+    return false;
   }
   auto directory_path = std::string(input_directory_path);
-  auto path = split(directory_path, '/');
-  image_descripton_ = path.back();
 
   auto file = readdir(directory);
   do {
     auto file_name = std::string(file->d_name);
-    if (file_name.size() < 3) {
-      continue;
-    }
-    auto file_extension = file_name.substr(file_name.size() - 3, 3);
-    if (file_extension == "TIF") {
-      int layer_index = std::stoi(file_name.substr(file_name.size() - 6, 1), nullptr,10);
-      auto input_image_file_path = directory_path + "/" + file_name;
-      TiffImage image_layer{};
-      image_layer.load_tiff(input_image_file_path.c_str());
-      push_back_image_layer(image_layer, input_image_file_path, layer_index);
+    int layer_index = LandsatImage::layer_index(file_name);
+    if (layer_index >= 0) {
+      push_back_image_layer(directory_path + "/" + file_name, layer_index, nullptr);
     }
   } while (nullptr != (file = readdir(directory)));
   closedir(directory);
+  return true;
 }
 
-void LandsatImage::push_back_image_layer(const TiffImage& image_layer, const std::string& path,
-  int layer_index) {
-  if (nullptr != image_layer.data()) {
-    switch (layer_index)
-    {
-      case 1 ... 6:
-        if(widht_ == 0 || height_ == 0) {
-          widht_ = image_layer.width();
-          height_ = image_layer.height();
-        }
-        break;
-      default:
-        std::cerr << "WARNING WaterCoherer: Omitted input image layer:\n" << "\t" + path <<
-        std::endl;
-        return;
+// Only band files are kept; other members, e.g. the panchromatic band, are skipped unread.
+bool LandsatImage::read_archive_layers(const char *input_archive_path) {
+  auto archive_path = std::string(input_archive_path);
+  auto wanted = [&archive_path](const std::string &file_name) {
+    int layer_index = LandsatImage::layer_index(file_name);
+    if (layer_index >= 0 && nullptr == layer_name(layer_index)) {
+      std::cerr << "WARNING WaterCoherer: Omitted input image layer:\n" << "\t" + archive_path +
+                "/" + file_name << std::endl;
     }
+    return layer_index >= 0 && nullptr != layer_name(layer_index);
+  };
+  auto read = [this, &archive_path](const std::string &file_name,
+                                    std::vector<unsigned char> bytes) {
+    std::unique_ptr<TiffBuffer> buffer(new TiffBuffer(archive_path + "/" + file_name,
+                                                      std::move(bytes)));
+    push_back_image_layer(std::string(), layer_index(file_name), std::move(buffer));
+  };
+  if (!SceneArchive::read_members(archive_path, wanted, read)) {
+    image_layers_.clear();
+    return false;
+  }
+  return true;
+}
 
-    switch (layer_index) {
-      case 1:
-        image_layers_.insert({std::string("blue"), image_layer});
-        break;
-      case 2:
-        image_layers_.insert({std::string("green"), image_layer});
-        break;
-      case 3:
-        image_layers_.insert({std::string("red"), image_layer});
-        break;
-      case 4:
-        image_layers_.insert({std::string("near infrared"), image_layer});
-        break;
-      case 5:
-        image_layers_.insert({std::string("shortwave infrared"), image_layer});
-        break;
-      case 6:
-        image_layers_.insert({std::string("thermal"), image_layer});
-        break;
-      default:
-        std::cerr << "WARNING WaterCoherer: Omitted input image layer:\n" << "\t" + path <<
-                  std::endl;
+void LandsatImage::describe_layers(const PixelWindow *window) {
+  if (nullptr != window) {
+    window_ = *window;
+  }
+  if (image_layers_.empty()) {
+    return;
+  }
+
+  // All bands of a scene share one grid, so any of them tells its size and placement.
+  const auto &layer = *image_layers_.begin()->second;
+  georeference_ = read_georeference(layer);
+  if (window_) {
+    widht_ = window_->width;
+    height_ = window_->height;
+    if (georeference_.valid()) {
+      georeference_ = georeference_.window(*window_);
+    }
+  } else {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    if (read_size(layer, width, height)) {
+      widht_ = width;
+      height_ = height;
     }
   }
 }
 
+void LandsatImage::push_back_image_layer(const std::string& path, int layer_index,
+                                         std::unique_ptr<TiffBuffer> buffer) {
+  const char *name = layer_name(layer_index);
+  if (nullptr == name) {
+    std::cerr << "WARNING WaterCoherer: Omitted input image layer:\n" << "\t" + path <<
+              std::endl;
+    return;
+  }
+  std::unique_ptr<LazyLayer> layer(new LazyLayer());
+  layer->path = path;
+  layer->buffer = std::move(buffer);
+  image_layers_.insert({std::string(name), std::move(layer)});
+}
+
+GeoReference LandsatImage::read_georeference(const LazyLayer &layer) {
+  return layer.buffer ? GeoReference::read(*layer.buffer) : GeoReference::read(layer.path);
+}
+
+bool LandsatImage::read_size(const LazyLayer &layer, unsigned int &width, unsigned int &height) {
+  return layer.buffer ? TiffReader::read_size(*layer.buffer, width, height)
+                      : TiffReader::read_size(layer.path, width, height);
+}
+
+// Uncompressed band files are mapped instead of read, unless only a window is wanted: the
+// mapping asks the kernel to read ahead the whole file, which is what a window avoids.
+void LandsatImage::decode_layer(LazyLayer &layer, ThreadPool &pool) const {
+  auto cores = pool.size();
+  if (layer.buffer) {
+    // The encoded band is dropped as soon as its pixels are out.
+    layer.image = window_ ? TiffReader::load_window(*layer.buffer, *window_, cores, pool)
+                          : TiffReader::load(*layer.buffer, cores, pool);
+    layer.buffer.reset();
+  } else if (window_) {
+    layer.image = TiffReader::load_window(layer.path, *window_, cores, pool);
+  } else if ((layer.mapped_file = MappedTiff::open(layer.path))) {
+    layer.mapped_file->read_pages(pool);
+    layer.image.assign(layer.mapped_file->view(), true);
+  } else {
+    layer.image = TiffReader::load(layer.path, cores, pool);
+  }
+}
+
+const TiffImage &LandsatImage::get_decoded_layer(LazyLayer &layer, ThreadPool &pool) const {
+  std::call_once(layer.decoded, [this, &layer, &pool]() { decode_layer(layer, pool); });
+  return layer.image;
+}
+
+void LandsatImage::prefetch(std::initializer_list<Band> bands, ThreadPool &pool) {
+  TaskGroup decoding(pool);
+  for (auto band : bands) {
+    auto layer = image_layers_.find(layer_name(band));
+    if (layer != image_layers_.end()) {
+      LazyLayer *lazy_layer = layer->second.get();
+      decoding.run([this, lazy_layer, &pool]() { get_decoded_layer(*lazy_layer, pool); });
+    }
+  }
+  decoding.wait();
+}
+
+const char *LandsatImage::layer_name(Band band) {
+  switch (band) {
+    case Band::Blue:
+      return "blue";
+    case Band::Green:
+      return "green";
+    case Band::Red:
+      return "red";
+    case Band::NearInfrared:
+      return "near infrared";
+    case Band::ShortwaveInfrared:
+      return "shortwave infrared";
+    case Band::Thermal:
+      return "thermal";
+  }
+  return "";
+}
+
+// Band files are numbered by their sixth character from the end, the 4 of <scene>_B40.TIF.
+const char *LandsatImage::layer_name(int layer_index) {
+  switch (layer_index) {
+    case 1:
+      return layer_name(Band::Blue);
+    case 2:
+      return layer_name(Band::Green);
+    case 3:
+      return layer_name(Band::Red);
+    case 4:
+      return layer_name(Band::NearInfrared);
+    case 5:
+      return layer_name(Band::ShortwaveInfrared);
+    case 6:
+      return layer_name(Band::Thermal);
+    default:
+      return nullptr;
+  }
+}
+
+// Returns -1 for files other than TIFF files.
+int LandsatImage::layer_index(const std::string &file_name) {
+  if (file_name.size() < 6 || file_name.substr(file_name.size() - 3, 3) != "TIF") {
+    return -1;
+  }
+  char digit = file_name[file_name.size() - 6];
+  return digit >= '0' && digit <= '9' ? digit - '0' : 0;
+}
+
 const TiffImage &LandsatImage::get_image_layer(const std::string &layer) {
-  return image_layers_.at(layer);
+  return get_decoded_layer(*image_layers_.at(layer), ThreadPool::instance());
 }
 
 const TiffImage &LandsatImage::view_red_layer() {
-  return get_image_layer("red");
+  return get_image_layer(layer_name(Band::Red));
 }
 
 const TiffImage &LandsatImage::view_green_layer() {
-  return get_image_layer("green");
+  return get_image_layer(layer_name(Band::Green));
 }
 
 const TiffImage &LandsatImage::view_blue_layer() {
-  return get_image_layer("blue");
+  return get_image_layer(layer_name(Band::Blue));
 }
 
 const TiffImage &LandsatImage::view_nir_layer() {
-  return get_image_layer("near infrared");
+  return get_image_layer(layer_name(Band::NearInfrared));
 }
 
 const TiffImage &LandsatImage::view_swir_layer() {
-  return get_image_layer("shortwave infrared");
+  return get_image_layer(layer_name(Band::ShortwaveInfrared));
 }
 
 const TiffImage &LandsatImage::view_termal_layer() {
-  return get_image_layer("thermal");
+  return get_image_layer(layer_name(Band::Thermal));
+}
+
+std::string LandsatImage::band_path(Band band) const {
+  auto layer = image_layers_.find(layer_name(band));
+  return layer != image_layers_.end() ? layer->second->path : std::string();
+}
+
+const GeoReference &LandsatImage::georeference() const {
+  return georeference_;
 }
 
 int LandsatImage::width() const {
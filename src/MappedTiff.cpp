@@ -0,0 +1,148 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "MappedTiff.hpp"
+#include "GeoReference.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tiffio.h>
+#include <unistd.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Offset of the first pixel when all strips are uncompressed and follow each other without
+  // gaps, so that the pixels form one row-major block of the file.
+  bool contiguous_pixels(const std::string &path, uint32_t &width, uint32_t &height,
+                         uint64_t &offset) {
+    GeoReference::register_tags();
+    TIFF *tiff = TIFFOpen(path.c_str(), "r");
+    if (nullptr == tiff) {
+      return false;
+    }
+
+    uint16_t bits_per_sample = 0;
+    uint16_t samples_per_pixel = 0;
+    uint16_t sample_format = 0;
+    uint16_t compression = 0;
+    uint16_t orientation = 0;
+    uint32_t rows_per_strip = 0;
+    bool contiguous = !TIFFIsTiled(tiff) &&
+                      TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width) &&
+                      TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height) &&
+                      TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample) &&
+                      TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel) &&
+                      TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sample_format) &&
+                      TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression) &&
+                      TIFFGetFieldDefaulted(tiff, TIFFTAG_ORIENTATION, &orientation) &&
+                      TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip) &&
+                      bits_per_sample == 8 && samples_per_pixel == 1 &&
+                      sample_format == SAMPLEFORMAT_UINT && compression == COMPRESSION_NONE &&
+                      orientation == ORIENTATION_TOPLEFT && width > 0 && height > 0;
+
+    uint32_t strips = contiguous ? TIFFNumberOfStrips(tiff) : 0;
+    offset = strips > 0 ? TIFFGetStrileOffset(tiff, 0) : 0;
+    uint64_t expected_offset = offset;
+    for (uint32_t strip = 0; contiguous && strip < strips; ++strip) {
+      uint64_t row = static_cast<uint64_t>(strip) * rows_per_strip;
+      uint64_t rows = row < height ? std::min<uint64_t>(rows_per_strip, height - row) : 0;
+      contiguous = TIFFGetStrileOffset(tiff, strip) == expected_offset &&
+                   TIFFGetStrileByteCount(tiff, strip) >= rows * width;
+      expected_offset += rows * width;
+    }
+    TIFFClose(tiff);
+    return contiguous && strips > 0 &&
+           expected_offset - offset == static_cast<uint64_t>(width) * height;
+  }
+}
+
+MappedTiff::~MappedTiff() {
+  if (address_) {
+    munmap(address_, size_);
+  }
+}
+
+std::shared_ptr<const MappedTiff> MappedTiff::open(const std::string &path) {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint64_t offset = 0;
+  if (!contiguous_pixels(path, width, height, offset)) {
+    return nullptr;
+  }
+
+  int file = ::open(path.c_str(), O_RDONLY);
+  if (file < 0) {
+    return nullptr;
+  }
+  struct stat status{};
+  uint64_t end = offset + static_cast<uint64_t>(width) * height;
+  if (fstat(file, &status) != 0 || static_cast<uint64_t>(status.st_size) < end) {
+    close(file);
+    return nullptr;
+  }
+
+  std::shared_ptr<MappedTiff> mapped(new MappedTiff());
+  mapped->size_ = static_cast<std::size_t>(status.st_size);
+  void *address = mmap(nullptr, mapped->size_, PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (address == MAP_FAILED) {
+    return nullptr;
+  }
+  mapped->address_ = address;
+
+  // Read-ahead of the pixels starts now, while the other bands are being opened.
+  auto *pixels = static_cast<const unsigned char *>(address) + offset;
+  madvise(address, mapped->size_, MADV_WILLNEED);
+  mapped->view_ = TiffImage(pixels, width, height, 1, 1, true);
+  return mapped;
+}
+
+const TiffImage &MappedTiff::view() const {
+  return view_;
+}
+
+void MappedTiff::read_pages(ThreadPool &pool) const {
+  const unsigned char *pixels = view_.data();
+  std::size_t size = view_.size();
+  std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  // Every worker reads one byte of each page of a contiguous share of the pixels.
+  unsigned int workers = pool.size();
+  pool.parallel_for(workers, [pixels, size, page, workers](unsigned int worker) {
+    std::size_t begin = size * worker / workers;
+    std::size_t end = size * (worker + 1) / workers;
+    auto *bytes = static_cast<const volatile unsigned char *>(pixels);
+    unsigned char sum = 0;
+    for (std::size_t offset = begin; offset < end; offset += page) {
+      sum += bytes[offset];
+    }
+    // The share need not start on a page, so its last page may lie past the last offset read.
+    if (begin < end) {
+      sum += bytes[end - 1];
+    }
+    static_cast<void>(sum);
+  });
+}
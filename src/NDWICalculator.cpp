@@ -21,12 +21,14 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "NDWICalculator.hpp"
+#include "RasterKernels.hpp"
+#include "RasterPartitioner.hpp"
 
+#include <chrono>
 #include <utility>
 #include <memory>
-#include <thread>
 #include <vector>
-#include <mutex>
+#include <algorithm>
 #include <NDWICalculator.hpp>
 
 using namespace WaterCoherer;
@@ -39,20 +41,12 @@ TiffImage NDWICalculator::generate_ndwi_layer_nir_swir(const TiffImage &nir_laye
     return result;
   }
 
-  cimg_forXY(result, x, y) {
-      float nir_value = nir_layer(static_cast<unsigned int>(x),
-                                  static_cast<unsigned int>(y));
-
-      float swir_value = swir_layer(static_cast<unsigned int>(x),
-                                    static_cast<unsigned int>(y));
-
-      if (nir_value > 1.f && swir_value > 1.f) {
-        float ndwi_level = (nir_value - swir_value) / (nir_value + swir_value);
-        if (ndwi_level > 1.f) {
-          result(static_cast<unsigned int>(x), static_cast<unsigned int>(y)) = 255;
-        }
-      }
-    }
+  std::vector<PixelMask::Word> words(PixelMask::words_for_width(result.width()));
+  for (unsigned int y = 0; y < static_cast<unsigned int>(result.height()); ++y) {
+    lookup_table(Method::NirSwir).classify_row(nir_layer.data(0, y), swir_layer.data(0, y),
+                                               result.width(), words.data());
+    RasterKernels::expand(words.data(), result.width(), result.data(0, y));
+  }
   return result;
 }
 
@@ -60,30 +54,21 @@ TiffImage NDWICalculator::generate_ndwi_layer_green_nir(const TiffImage &green_l
 TiffImage &nir_layer) {
   TiffImage result(green_layer.width(), green_layer.height(), 1, 1);
 
-  if (green_layer.height() != green_layer.height() || green_layer.width() != green_layer.width()) {
+  if (green_layer.height() != nir_layer.height() || green_layer.width() != nir_layer.width()) {
     return result;
   }
 
-  cimg_forXY(result, x, y) {
-      float green_value = green_layer(static_cast<unsigned int>(x),
-                                      static_cast<unsigned int>(y));
-
-      float nir_value = nir_layer(static_cast<unsigned int>(x),
-                                  static_cast<unsigned int>(y));
-
-      if (green_value > 1.f && nir_value > 1.f) {
-        float ndwi_level = (green_value - nir_value) / (green_value + nir_value);
-        if (ndwi_level >= 0.33f) {
-          result(static_cast<unsigned int>(x), static_cast<unsigned int>(y)) = 255;
-        }
-      }
-    }
+  std::vector<PixelMask::Word> words(PixelMask::words_for_width(result.width()));
+  for (unsigned int y = 0; y < static_cast<unsigned int>(result.height()); ++y) {
+    lookup_table(Method::GreenNir).classify_row(green_layer.data(0, y), nir_layer.data(0, y),
+                                                result.width(), words.data());
+    RasterKernels::expand(words.data(), result.width(), result.data(0, y));
+  }
   return result;
 }
 
 TiffImage NDWICalculator::generate_ndwi_layer_green_nir_high_performance(
   const TiffImage &green_layer, const TiffImage &nir_layer, unsigned int cores) {
-  std::vector<std::thread> thread_pool;
 
   auto start = std::chrono::system_clock::now();
   TiffImage result(green_layer.width(), green_layer.height(), 1, 1);
@@ -92,70 +77,53 @@ TiffImage NDWICalculator::generate_ndwi_layer_green_nir_high_performance(
   std::cout << std::to_string(elapsed.count()) + ",";
 
   start = std::chrono::system_clock::now();
-  for (unsigned int i = 0UL; i < cores; ++i) {
-    thread_pool.emplace_back(
-      std::thread([i, cores, &result, &green_layer, &nir_layer]() {
-        unsigned int height = green_layer.height() / cores;
-        unsigned int start = i > 0 ? height * i : height * i + 1;
-        unsigned int stop = i < cores - 1 ? height * (i + 1) + 1 : (height * (i + 1));
-
-        for (unsigned int y = start; y < stop - 1; ++y) {
-          for (unsigned int x = 0; x < static_cast<unsigned int>(green_layer.width()); ++x) {
-            float green_value = green_layer(x, y);
-            float nir_value = nir_layer(x, y);
-
-            if (green_value > 1.f && nir_value > 1.f) {
-              float ndwi_level = (green_value - nir_value) / (green_value + nir_value);
-              result(x, y) = static_cast<unsigned char>(ndwi_level >= 0.33f ? 255 : 0);
-            }
-          }
-        }
-      }));
-  }
-
-  for (auto &&thread : thread_pool) {
-    thread.join();
-  }
+  RasterPartitioner partitioner(result.width(), result.height());
+  partitioner.run(cores, [&result, &green_layer, &nir_layer](const RasterTile &tile) {
+    std::vector<PixelMask::Word> words(PixelMask::words_for_width(tile.width()));
+    for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+      lookup_table(Method::GreenNir).classify_row(green_layer.data(tile.x_begin, y),
+                                                  nir_layer.data(tile.x_begin, y), tile.width(),
+                                                  words.data());
+      RasterKernels::expand(words.data(), tile.width(), result.data(tile.x_begin, y));
+    }
+  });
   stop = std::chrono::system_clock::now();
   elapsed = std::chrono::duration<double>(stop - start);
   std::cout << std::to_string(elapsed.count()) + ",";
   return result;
 }
 
-PixelPositions NDWICalculator::localize_water(unsigned int cores,
-                                              const TiffImage &green_layer,
-                                              const TiffImage &nir_layer) {
-  std::vector<std::thread> thread_pool;
-  std::mutex result_mutex;
-  PixelPositions result;
-  auto start = std::chrono::system_clock::now();
-  for (unsigned int i = 0UL; i < cores; ++i) {
-    thread_pool.emplace_back(
-      std::thread([i, cores, &result, &green_layer, &nir_layer, &result_mutex]() {
-        unsigned int height = green_layer.height() / cores;
-        unsigned int start = i > 0 ? height * i : height * i + 1;
-        unsigned int stop = i < cores - 1 ? height * (i + 1) + 1 : (height * (i + 1));
-
-        for (unsigned int y = start; y < stop - 1; ++y) {
-          for (unsigned int x = 0; x < static_cast<unsigned int>(green_layer.width()); ++x) {
-            float green_value = green_layer(x, y);
-            float nir_value = nir_layer(x, y);
-
-            if (green_value > 1.f && nir_value > 1.f) {
-              float ndwi_level = (green_value - nir_value) / (green_value + nir_value);
-              if (ndwi_level >= 0.33f) {
-                std::lock_guard<std::mutex> guard(result_mutex);
-                result.insert({x, y});
-              }
-            }
-          }
-        }
-      }));
+const TwoBandLookupTable &NDWICalculator::lookup_table(Method method) {
+  static const TwoBandLookupTable green_nir = lookup_table(Method::GreenNir, 0.33f);
+  static const TwoBandLookupTable nir_swir = lookup_table(Method::NirSwir, 1.f);
+  switch (method) {
+    case Method::GreenNir:
+      return green_nir;
+    case Method::NirSwir:
+      return nir_swir;
+    default:
+      std::cerr << "NDWI Calculator: Invalid method!" << std::endl;
+      std::exit(1);
   }
+}
 
-  for (auto &&thread : thread_pool) {
-    thread.join();
+TwoBandLookupTable NDWICalculator::lookup_table(Method method, float threshold) {
+  switch (method) {
+    case Method::GreenNir:
+      return TwoBandLookupTable::normalized_difference(threshold, true);
+    case Method::NirSwir:
+      return TwoBandLookupTable::normalized_difference(threshold, false);
+    default:
+      std::cerr << "NDWI Calculator: Invalid method!" << std::endl;
+      std::exit(1);
   }
+}
+
+PixelMask NDWICalculator::localize_water(unsigned int cores,
+                                         const TiffImage &green_layer,
+                                         const TiffImage &nir_layer) {
+  auto start = std::chrono::system_clock::now();
+  auto result = localize_water(cores, green_layer, nir_layer, lookup_table(Method::GreenNir));
   auto stop = std::chrono::system_clock::now();
   auto elapsed = std::chrono::duration<double>(stop - start);
   std::cout << std::to_string(elapsed.count()) + ",";
@@ -163,43 +131,156 @@ PixelPositions NDWICalculator::localize_water(unsigned int cores,
   return result;
 }
 
-PixelPositions NDWICalculator::localize_water(unsigned int cores, const TiffImage &green_layer,
-                                              const TiffImage &nir_layer,
-                                              const PixelPositions &omitted_pixels) {
-  std::vector<std::thread> thread_pool;
-  std::mutex result_mutex;
-  PixelPositions result;
-  for (unsigned int i = 0UL; i < cores; ++i) {
-    thread_pool.emplace_back(
-      std::thread([i, cores, &result, &green_layer, &nir_layer, &result_mutex, &omitted_pixels]() {
-        unsigned int height = green_layer.height() / cores;
-        unsigned int start = i > 0 ? height * i : height * i + 1;
-        unsigned int stop = i < cores - 1 ? height * (i + 1) + 1 : (height * (i + 1));
-
-        for (unsigned int y = start; y < stop - 1; ++y) {
-          for (unsigned int x = 0; x < static_cast<unsigned int>(green_layer.width()); ++x) {
-            if (omitted_pixels.count({x, y})) {
-              continue;
-            }
-
-            float green_value = green_layer(x, y);
-            float nir_value = nir_layer(x, y);
-
-            if (green_value > 1.f && nir_value > 1.f) {
-              float ndwi_level = (green_value - nir_value) / (green_value + nir_value);
-              if (ndwi_level >= 0.33f) {
-                std::lock_guard<std::mutex> guard(result_mutex);
-                result.insert({x, y});
-              }
-            }
-          }
-        }
-      }));
+PixelMask NDWICalculator::localize_water(unsigned int cores, const TiffImage &green_layer,
+                                         const TiffImage &nir_layer,
+                                         const PixelMask &omitted_pixels) {
+  return localize_water(cores, green_layer, nir_layer, lookup_table(Method::GreenNir),
+                        omitted_pixels);
+}
+
+PixelMask NDWICalculator::localize_water(unsigned int cores, const TiffImage &first_layer,
+                                         const TiffImage &second_layer,
+                                         const TwoBandLookupTable &classification) {
+  PixelMask result(first_layer.width(), first_layer.height());
+  RasterPartitioner partitioner(result.width(), result.height());
+  partitioner.run(cores, [&result, &first_layer, &second_layer,
+                          &classification](const RasterTile &tile) {
+    for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+      classification.classify_row(first_layer.data(tile.x_begin, y),
+                                  second_layer.data(tile.x_begin, y), tile.width(),
+                                  result.row(y) + tile.x_begin / PixelMask::word_bits);
+    }
+  });
+  return result;
+}
+
+PixelMask NDWICalculator::localize_water(unsigned int cores, const TiffImage &first_layer,
+                                         const TiffImage &second_layer,
+                                         const TwoBandLookupTable &classification,
+                                         const PixelMask &omitted_pixels) {
+  PixelMask result(first_layer.width(), first_layer.height());
+  if (!result.same_size(omitted_pixels)) {
+    std::cerr << "NDWI Calculator: Omitted pixels mask does not match the layers!" << std::endl;
+    return result;
+  }
+
+  RasterPartitioner partitioner(result.width(), result.height());
+  partitioner.run(cores, [&result, &first_layer, &second_layer, &classification,
+                          &omitted_pixels](const RasterTile &tile) {
+    std::size_t word_begin = tile.x_begin / PixelMask::word_bits;
+    std::size_t word_count = PixelMask::words_for_width(tile.width());
+
+    // Omitted pixels are cleared from whole words after classification instead of being
+    // tested pixel by pixel.
+    for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+      PixelMask::Word *words = result.row(y) + word_begin;
+      classification.classify_row(first_layer.data(tile.x_begin, y),
+                                  second_layer.data(tile.x_begin, y), tile.width(), words);
+      RasterKernels::subtract(words, omitted_pixels.row(y) + word_begin, word_count);
+    }
+  });
+  return result;
+}
+
+PixelMask NDWICalculator::localize_water(unsigned int cores, const TiffImage &green_layer,
+                                         const TiffImage &nir_layer,
+                                         const RunLengthMask &omitted_pixels) {
+  // An empty mask omits nothing, as in RunLengthMask::unite.
+  if (omitted_pixels.empty()) {
+    return localize_water(cores, green_layer, nir_layer, lookup_table(Method::GreenNir));
+  }
+  PixelMask result(green_layer.width(), green_layer.height());
+  if (omitted_pixels.width() != result.width() || omitted_pixels.height() != result.height()) {
+    std::cerr << "NDWI Calculator: Omitted pixels mask does not match the layers!" << std::endl;
+    return result;
   }
 
-  for (auto &&thread : thread_pool) {
-    thread.join();
+  const TwoBandLookupTable &green_nir = lookup_table(Method::GreenNir);
+  RasterPartitioner partitioner(result.width(), result.height());
+  partitioner.run(cores, [&result, &green_layer, &nir_layer, &omitted_pixels,
+                          &green_nir](const RasterTile &tile) {
+    constexpr unsigned int word_bits = PixelMask::word_bits;
+    std::vector<PixelMask::Word> gap_words(PixelMask::words_for_width(tile.width()));
+    // Only the gaps between omitted runs are classified; omitted runs are skipped whole. A gap
+    // is classified from the start of its first word and the pixels before it are masked off,
+    // since the words of two gaps may overlap.
+    auto classify_gap = [&result, &green_layer, &nir_layer, &green_nir,
+                         &gap_words](unsigned int y, unsigned int x_begin, unsigned int x_end) {
+      unsigned int aligned_begin = x_begin - x_begin % word_bits;
+      green_nir.classify_row(green_layer.data(aligned_begin, y), nir_layer.data(aligned_begin, y),
+                             x_end - aligned_begin, gap_words.data());
+      PixelMask::Word *words = result.row(y) + aligned_begin / word_bits;
+      gap_words[0] &= ~PixelMask::Word{0} << (x_begin % word_bits);
+      for (std::size_t i = 0; i < PixelMask::words_for_width(x_end - aligned_begin); ++i) {
+        words[i] |= gap_words[i];
+      }
+    };
+    for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+      unsigned int x_begin = tile.x_begin;
+      auto run = omitted_pixels.row_begin(y);
+      while (run != omitted_pixels.row_end(y) && run->end <= x_begin) {
+        ++run;
+      }
+      while (x_begin < tile.x_end) {
+        unsigned int x_end = run != omitted_pixels.row_end(y) ?
+                             std::min(std::max(run->begin, x_begin), tile.x_end) : tile.x_end;
+        if (x_begin < x_end) {
+          classify_gap(y, x_begin, x_end);
+        }
+        if (run == omitted_pixels.row_end(y)) {
+          break;
+        }
+        x_begin = run->end;
+        ++run;
+      }
+    }
+  });
+  return result;
+}
+
+TiledMask NDWICalculator::localize_water_tiled(unsigned int cores, const TiffImage &green_layer,
+                                               const TiffImage &nir_layer) {
+  return localize_water_tiled(cores, green_layer, nir_layer,
+                              TiledMask(green_layer.width(), green_layer.height()));
+}
+
+TiledMask NDWICalculator::localize_water_tiled(unsigned int cores, const TiffImage &green_layer,
+                                               const TiffImage &nir_layer,
+                                               const TiledMask &omitted_pixels) {
+  TiledMask result(green_layer.width(), green_layer.height());
+  if (!result.same_size(omitted_pixels)) {
+    std::cerr << "NDWI Calculator: Omitted pixels mask does not match the layers!" << std::endl;
+    return result;
   }
+
+  const TwoBandLookupTable &green_nir = lookup_table(Method::GreenNir);
+  RasterPartitioner partitioner(result.width(), result.height(),
+                                RasterPartitioner::default_tile_width, TiledMask::tile_size);
+  partitioner.run(cores, [&result, &green_layer, &nir_layer, &omitted_pixels,
+                          &green_nir](const RasterTile &tile) {
+    TiledMask::Word rows[TiledMask::tile_size];
+    unsigned int tile_y = tile.y_begin / TiledMask::tile_size;
+    for (unsigned int tile_x = tile.x_begin / TiledMask::tile_size;
+         tile_x * TiledMask::tile_size < tile.x_end; ++tile_x) {
+      // Fully omitted tiles cannot contain water, so their pixels are never read.
+      auto omitted_state = omitted_pixels.tile_state(tile_x, tile_y);
+      if (omitted_state == TiledMask::TileState::Full) {
+        result.fill_tile(tile_x, tile_y, TiledMask::TileState::Empty);
+        continue;
+      }
+
+      const TiledMask::Word *omitted_rows = omitted_pixels.tile_rows(tile_x, tile_y);
+      unsigned int x_begin = tile_x * TiledMask::tile_size;
+      unsigned int y_begin = tile_y * TiledMask::tile_size;
+      for (unsigned int y = 0; y < result.tile_height(tile_y); ++y) {
+        green_nir.classify_row(green_layer.data(x_begin, y_begin + y),
+                               nir_layer.data(x_begin, y_begin + y),
+                               result.tile_width(tile_x), rows + y);
+        rows[y] &= omitted_rows ? ~omitted_rows[y] : ~TiledMask::Word{0};
+      }
+      result.store_tile(tile_x, tile_y, rows);
+    }
+  });
   return result;
 }
 
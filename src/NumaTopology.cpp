@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "NumaTopology.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Parses the kernel's list format, e.g. "0-7,16-23".
+  std::vector<unsigned int> read_cpu_list(const std::string &path) {
+    std::vector<unsigned int> result;
+    std::ifstream file(path);
+    std::string list;
+    if (!std::getline(file, list)) {
+      return result;
+    }
+
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+      if (range.empty()) {
+        continue;
+      }
+      auto separator = range.find('-');
+      try {
+        unsigned long first = std::stoul(range.substr(0, separator));
+        unsigned long last = separator == std::string::npos ? first :
+                             std::stoul(range.substr(separator + 1));
+        for (unsigned long cpu = first; cpu <= last; ++cpu) {
+          result.push_back(static_cast<unsigned int>(cpu));
+        }
+      } catch (const std::exception &) {
+        return std::vector<unsigned int>();
+      }
+    }
+    return result;
+  }
+}
+
+NumaTopology::NumaTopology() {
+  for (unsigned int node : read_cpu_list("/sys/devices/system/node/online")) {
+    auto cpus = read_cpu_list("/sys/devices/system/node/node" + std::to_string(node) +
+                              "/cpulist");
+    if (!cpus.empty()) {
+      node_cpus_.push_back(std::move(cpus));
+    }
+  }
+  if (node_cpus_.empty()) {
+    node_cpus_.emplace_back();
+    for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu) {
+      node_cpus_.back().push_back(cpu);
+    }
+  }
+
+  for (unsigned int node = 0; node < node_cpus_.size(); ++node) {
+    for (unsigned int cpu : node_cpus_[node]) {
+      if (cpu >= cpu_nodes_.size()) {
+        cpu_nodes_.resize(cpu + 1, 0);
+      }
+      cpu_nodes_[cpu] = node;
+    }
+  }
+}
+
+const NumaTopology &NumaTopology::instance() {
+  static const NumaTopology topology;
+  return topology;
+}
+
+unsigned int NumaTopology::node_count() const {
+  return static_cast<unsigned int>(node_cpus_.size());
+}
+
+const std::vector<unsigned int> &NumaTopology::node_cpus(unsigned int node) const {
+  return node_cpus_.at(node);
+}
+
+unsigned int NumaTopology::node_of_cpu(unsigned int cpu) const {
+  return cpu < cpu_nodes_.size() ? cpu_nodes_[cpu] : 0;
+}
+
+unsigned int NumaTopology::current_node() const {
+  if (node_cpus_.size() == 1) {
+    return 0;
+  }
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : node_of_cpu(static_cast<unsigned int>(cpu));
+}
+
+bool NumaTopology::pin_current_thread(const std::vector<unsigned int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return CPU_COUNT(&set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
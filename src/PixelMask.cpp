@@ -0,0 +1,154 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "PixelMask.hpp"
+#include <array>
+#include <iostream>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Masks keep the first pixel of a byte in its least significant bit, TIFF in its most.
+  constexpr std::array<unsigned char, 256> reversed_bytes = []() {
+    std::array<unsigned char, 256> result{};
+    for (unsigned int value = 0; value < 256; ++value) {
+      unsigned int reversed = 0;
+      for (unsigned int bit = 0; bit < 8; ++bit) {
+        reversed |= ((value >> bit) & 1U) << (7 - bit);
+      }
+      result[value] = static_cast<unsigned char>(reversed);
+    }
+    return result;
+  }();
+}
+
+PixelMask::PixelMask(unsigned int width, unsigned int height) :
+  width_(width), height_(height), words_per_row_(words_for_width(width)),
+  words_(words_per_row_ * height, 0) {
+}
+
+unsigned int PixelMask::width() const {
+  return width_;
+}
+
+unsigned int PixelMask::height() const {
+  return height_;
+}
+
+std::size_t PixelMask::words_per_row() const {
+  return words_per_row_;
+}
+
+bool PixelMask::same_size(const PixelMask &other) const {
+  return width_ == other.width_ && height_ == other.height_;
+}
+
+void PixelMask::pack_msb_first(unsigned int y, unsigned int x_begin, unsigned int count,
+                               unsigned char *bytes) const {
+  const Word *words = row(y);
+  unsigned int first_byte = x_begin / 8;
+  for (unsigned int i = 0; i < (count + 7) / 8; ++i) {
+    unsigned int byte = first_byte + i;
+    unsigned int x = byte * 8;
+    unsigned char value = 0;
+    if (x < width_) {
+      value = reversed_bytes[(words[byte / 8] >> (8 * (byte % 8))) & 0xFF];
+      if (width_ - x < 8) {
+        value &= static_cast<unsigned char>(0xFF << (8 - (width_ - x)));
+      }
+    }
+    bytes[i] = value;
+  }
+}
+
+void PixelMask::unpack_msb_first(unsigned int y, unsigned int x_begin, unsigned int count,
+                                 const unsigned char *bytes) {
+  Word *words = row(y);
+  unsigned int first_byte = x_begin / 8;
+  for (unsigned int i = 0; i < (count + 7) / 8; ++i) {
+    unsigned int byte = first_byte + i;
+    unsigned int x = byte * 8;
+    if (x >= width_) {
+      break;
+    }
+    Word value = reversed_bytes[bytes[i]];
+    if (width_ - x < 8) {
+      value &= (Word{1} << (width_ - x)) - 1;
+    }
+    unsigned int shift = 8 * (byte % 8);
+    words[byte / 8] = (words[byte / 8] & ~(Word{0xFF} << shift)) | (value << shift);
+  }
+}
+
+std::size_t PixelMask::count() const {
+  std::size_t result = 0;
+  for (auto word : words_) {
+    result += static_cast<std::size_t>(__builtin_popcountll(word));
+  }
+  return result;
+}
+
+bool PixelMask::any() const {
+  for (auto word : words_) {
+    if (word) {
+      return true;
+    }
+  }
+  return false;
+}
+
+PixelMask &PixelMask::operator|=(const PixelMask &other) {
+  if (words_.empty()) {
+    return *this = other;
+  }
+  if (!same_size(other)) {
+    std::cerr << "WARNING WaterCoherer: Omitted pixel mask of different size." << std::endl;
+    return *this;
+  }
+  for (std::size_t i = 0; i < words_.size(); ++i) {
+    words_[i] |= other.words_[i];
+  }
+  return *this;
+}
+
+PixelMask &PixelMask::operator&=(const PixelMask &other) {
+  if (!same_size(other)) {
+    std::cerr << "WARNING WaterCoherer: Omitted pixel mask of different size." << std::endl;
+    return *this;
+  }
+  for (std::size_t i = 0; i < words_.size(); ++i) {
+    words_[i] &= other.words_[i];
+  }
+  return *this;
+}
+
+PixelMask &PixelMask::subtract(const PixelMask &other) {
+  if (!same_size(other)) {
+    std::cerr << "WARNING WaterCoherer: Omitted pixel mask of different size." << std::endl;
+    return *this;
+  }
+  for (std::size_t i = 0; i < words_.size(); ++i) {
+    words_[i] &= ~other.words_[i];
+  }
+  return *this;
+}
@@ -0,0 +1,449 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "RasterKernels.hpp"
+#include <algorithm>
+#include <atomic>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define WATERCOHERER_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace WaterCoherer;
+
+namespace {
+  using Word = RasterKernels::Word;
+  constexpr unsigned int word_bits = PixelMask::word_bits;
+
+  struct KernelTable {
+    RasterKernels::InstructionSet instruction_set;
+    void (*threshold_above)(const unsigned char *, unsigned int, unsigned char, Word *);
+    void (*lookup_two_band)(const unsigned char *, const unsigned char *, const unsigned char *,
+                            unsigned int, Word *);
+    void (*unite)(Word *, const Word *, std::size_t);
+    void (*subtract)(Word *, const Word *, std::size_t);
+    void (*expand)(const Word *, unsigned int, unsigned char *);
+  };
+
+  namespace scalar {
+    void threshold_above(const unsigned char *values, unsigned int width, unsigned char threshold,
+                         Word *words) {
+      for (unsigned int x_begin = 0; x_begin < width; x_begin += word_bits) {
+        unsigned int size = std::min(word_bits, width - x_begin);
+        Word word = 0;
+        for (unsigned int x = 0; x < size; ++x) {
+          word |= Word{values[x_begin + x] > threshold} << x;
+        }
+        words[x_begin / word_bits] = word;
+      }
+    }
+
+    void lookup_two_band(const unsigned char *table, const unsigned char *first,
+                         const unsigned char *second, unsigned int width, Word *words) {
+      for (unsigned int x_begin = 0; x_begin < width; x_begin += word_bits) {
+        unsigned int size = std::min(word_bits, width - x_begin);
+        Word word = 0;
+        for (unsigned int x = 0; x < size; ++x) {
+          unsigned int index = static_cast<unsigned int>(first[x_begin + x]) << 8 |
+                               second[x_begin + x];
+          word |= static_cast<Word>(table[index] != 0) << x;
+        }
+        words[x_begin / word_bits] = word;
+      }
+    }
+
+    void unite(Word *words, const Word *other, std::size_t size) {
+      for (std::size_t i = 0; i < size; ++i) {
+        words[i] |= other[i];
+      }
+    }
+
+    void subtract(Word *words, const Word *omitted, std::size_t size) {
+      for (std::size_t i = 0; i < size; ++i) {
+        words[i] &= ~omitted[i];
+      }
+    }
+
+    void expand(const Word *words, unsigned int width, unsigned char *pixels) {
+      for (unsigned int x = 0; x < width; ++x) {
+        pixels[x] = ((words[x / word_bits] >> (x % word_bits)) & 1U) ? 255 : 0;
+      }
+    }
+
+    constexpr KernelTable table = {
+      RasterKernels::InstructionSet::Scalar, threshold_above, lookup_two_band, unite, subtract,
+      expand
+    };
+  }
+
+#ifdef WATERCOHERER_X86_KERNELS
+  // The vector implementations handle whole words of 64 pixels and leave the tail of a row to
+  // the scalar implementation.
+
+  namespace sse2 {
+    Word threshold_word(const unsigned char *values, unsigned char threshold) {
+      const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+      const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold ^ 0x80));
+      Word word = 0;
+      for (unsigned int x = 0; x < word_bits; x += 16) {
+        __m128i value = _mm_xor_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + x)), bias);
+        auto bits = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpgt_epi8(value, limit)));
+        word |= Word{bits} << x;
+      }
+      return word;
+    }
+
+    void threshold_above(const unsigned char *values, unsigned int width, unsigned char threshold,
+                         Word *words) {
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        words[i] = threshold_word(values + i * word_bits, threshold);
+      }
+      scalar::threshold_above(values + full_words * word_bits, width % word_bits, threshold,
+                              words + full_words);
+    }
+
+    void unite(Word *words, const Word *other, std::size_t size) {
+      std::size_t i = 0;
+      for (; i + 2 <= size; i += 2) {
+        auto *target = reinterpret_cast<__m128i *>(words + i);
+        _mm_storeu_si128(target, _mm_or_si128(
+          _mm_loadu_si128(target), _mm_loadu_si128(reinterpret_cast<const __m128i *>(other + i))));
+      }
+      scalar::unite(words + i, other + i, size - i);
+    }
+
+    void subtract(Word *words, const Word *omitted, std::size_t size) {
+      std::size_t i = 0;
+      for (; i + 2 <= size; i += 2) {
+        auto *target = reinterpret_cast<__m128i *>(words + i);
+        _mm_storeu_si128(target, _mm_andnot_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(omitted + i)),
+          _mm_loadu_si128(target)));
+      }
+      scalar::subtract(words + i, omitted + i, size - i);
+    }
+
+    void expand(const Word *words, unsigned int width, unsigned char *pixels) {
+      const __m128i bits = _mm_set1_epi64x(static_cast<long long>(0x8040201008040201ULL));
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        for (unsigned int x = 0; x < word_bits; x += 16) {
+          Word low = (words[i] >> x) & 0xFFU;
+          Word high = (words[i] >> (x + 8)) & 0xFFU;
+          __m128i value = _mm_set_epi64x(static_cast<long long>(high * 0x0101010101010101ULL),
+                                         static_cast<long long>(low * 0x0101010101010101ULL));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i * word_bits + x),
+                           _mm_cmpeq_epi8(_mm_and_si128(value, bits), bits));
+        }
+      }
+      scalar::expand(words + full_words, width % word_bits, pixels + full_words * word_bits);
+    }
+
+    const KernelTable table = {
+      // SSE2 has no gather, table lookups stay scalar.
+      RasterKernels::InstructionSet::SSE2, threshold_above, scalar::lookup_two_band, unite,
+      subtract, expand
+    };
+  }
+
+  namespace avx2 {
+    __attribute__((target("avx2")))
+    void threshold_above(const unsigned char *values, unsigned int width, unsigned char threshold,
+                         Word *words) {
+      const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+      const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold ^ 0x80));
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        Word word = 0;
+        for (unsigned int x = 0; x < word_bits; x += 32) {
+          __m256i value = _mm256_xor_si256(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(values + i * word_bits + x)), bias);
+          auto bits = static_cast<unsigned int>(
+            _mm256_movemask_epi8(_mm256_cmpgt_epi8(value, limit)));
+          word |= Word{bits} << x;
+        }
+        words[i] = word;
+      }
+      scalar::threshold_above(values + full_words * word_bits, width % word_bits, threshold,
+                              words + full_words);
+    }
+
+    __attribute__((target("avx2")))
+    void lookup_two_band(const unsigned char *table, const unsigned char *first,
+                         const unsigned char *second, unsigned int width, Word *words) {
+      auto base = reinterpret_cast<const int *>(table);
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        Word word = 0;
+        for (unsigned int x = 0; x < word_bits; x += 8) {
+          __m256i first_value = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(first + i * word_bits + x)));
+          __m256i second_value = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(second + i * word_bits + x)));
+          __m256i index = _mm256_or_si256(_mm256_slli_epi32(first_value, 8), second_value);
+          // Entries are 0 or 1, so shifting the gathered low byte into the sign bit yields the
+          // classification mask.
+          __m256i entry = _mm256_slli_epi32(_mm256_i32gather_epi32(base, index, 1), 31);
+          auto bits = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(entry)));
+          word |= Word{bits} << x;
+        }
+        words[i] = word;
+      }
+      scalar::lookup_two_band(table, first + full_words * word_bits,
+                              second + full_words * word_bits, width % word_bits,
+                              words + full_words);
+    }
+
+    __attribute__((target("avx2")))
+    void unite(Word *words, const Word *other, std::size_t size) {
+      std::size_t i = 0;
+      for (; i + 4 <= size; i += 4) {
+        auto *target = reinterpret_cast<__m256i *>(words + i);
+        _mm256_storeu_si256(target, _mm256_or_si256(
+          _mm256_loadu_si256(target),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(other + i))));
+      }
+      scalar::unite(words + i, other + i, size - i);
+    }
+
+    __attribute__((target("avx2")))
+    void subtract(Word *words, const Word *omitted, std::size_t size) {
+      std::size_t i = 0;
+      for (; i + 4 <= size; i += 4) {
+        auto *target = reinterpret_cast<__m256i *>(words + i);
+        _mm256_storeu_si256(target, _mm256_andnot_si256(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(omitted + i)),
+          _mm256_loadu_si256(target)));
+      }
+      scalar::subtract(words + i, omitted + i, size - i);
+    }
+
+    __attribute__((target("avx2")))
+    void expand(const Word *words, unsigned int width, unsigned char *pixels) {
+      // Every byte picks the byte of the mask holding its bit and compares it with its own bit.
+      const __m256i select = _mm256_setr_epi64x(0, 0x0101010101010101LL, 0x0202020202020202LL,
+                                                0x0303030303030303LL);
+      const __m256i bits = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ULL));
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        for (unsigned int x = 0; x < word_bits; x += 32) {
+          auto half = static_cast<int>(static_cast<unsigned int>(words[i] >> x));
+          __m256i value = _mm256_shuffle_epi8(_mm256_set1_epi32(half), select);
+          _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i * word_bits + x),
+                              _mm256_cmpeq_epi8(_mm256_and_si256(value, bits), bits));
+        }
+      }
+      scalar::expand(words + full_words, width % word_bits, pixels + full_words * word_bits);
+    }
+
+    const KernelTable table = {
+      RasterKernels::InstructionSet::AVX2, threshold_above, lookup_two_band, unite, subtract,
+      expand
+    };
+  }
+
+  namespace avx512 {
+    __attribute__((target("avx512f,avx512bw")))
+    void threshold_above(const unsigned char *values, unsigned int width, unsigned char threshold,
+                         Word *words) {
+      const __m512i limit = _mm512_set1_epi8(static_cast<char>(threshold));
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        words[i] = _mm512_cmpgt_epu8_mask(_mm512_loadu_si512(values + i * word_bits), limit);
+      }
+      scalar::threshold_above(values + full_words * word_bits, width % word_bits, threshold,
+                              words + full_words);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void lookup_two_band(const unsigned char *table, const unsigned char *first,
+                         const unsigned char *second, unsigned int width, Word *words) {
+      // GCC's unmasked forms of these intrinsics start from an undefined vector and warn about
+      // it, so the masked forms are used with every lane selected.
+      const __mmask16 lanes = 0xFFFF;
+      const __m512i entry_bit = _mm512_set1_epi32(1);
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        Word word = 0;
+        for (unsigned int x = 0; x < word_bits; x += 16) {
+          __m512i first_value = _mm512_maskz_cvtepu8_epi32(
+            lanes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + i * word_bits + x)));
+          __m512i second_value = _mm512_maskz_cvtepu8_epi32(
+            lanes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(second + i * word_bits + x)));
+          __m512i index = _mm512_or_si512(_mm512_maskz_slli_epi32(lanes, first_value, 8),
+                                          second_value);
+          __m512i entry = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), lanes, index, table,
+                                                      1);
+          word |= Word{_mm512_test_epi32_mask(entry, entry_bit)} << x;
+        }
+        words[i] = word;
+      }
+      scalar::lookup_two_band(table, first + full_words * word_bits,
+                              second + full_words * word_bits, width % word_bits,
+                              words + full_words);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void unite(Word *words, const Word *other, std::size_t size) {
+      std::size_t i = 0;
+      for (; i + 8 <= size; i += 8) {
+        _mm512_storeu_si512(words + i, _mm512_or_si512(_mm512_loadu_si512(words + i),
+                                                       _mm512_loadu_si512(other + i)));
+      }
+      scalar::unite(words + i, other + i, size - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void subtract(Word *words, const Word *omitted, std::size_t size) {
+      std::size_t i = 0;
+      for (; i + 8 <= size; i += 8) {
+        // Masked for the same reason as the gathers of lookup_two_band.
+        _mm512_storeu_si512(words + i, _mm512_maskz_andnot_epi64(0xFF,
+                                                                 _mm512_loadu_si512(omitted + i),
+                                                                 _mm512_loadu_si512(words + i)));
+      }
+      scalar::subtract(words + i, omitted + i, size - i);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    void expand(const Word *words, unsigned int width, unsigned char *pixels) {
+      unsigned int full_words = width / word_bits;
+      for (unsigned int i = 0; i < full_words; ++i) {
+        _mm512_storeu_si512(pixels + i * word_bits, _mm512_movm_epi8(words[i]));
+      }
+      scalar::expand(words + full_words, width % word_bits, pixels + full_words * word_bits);
+    }
+
+    const KernelTable table = {
+      RasterKernels::InstructionSet::AVX512, threshold_above, lookup_two_band, unite, subtract,
+      expand
+    };
+  }
+#endif
+
+  bool supported(RasterKernels::InstructionSet instruction_set) {
+    switch (instruction_set) {
+      case RasterKernels::InstructionSet::Scalar:
+        return true;
+#ifdef WATERCOHERER_X86_KERNELS
+      case RasterKernels::InstructionSet::SSE2:
+        return __builtin_cpu_supports("sse2");
+      case RasterKernels::InstructionSet::AVX2:
+        return __builtin_cpu_supports("avx2");
+      case RasterKernels::InstructionSet::AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+      default:
+        return false;
+    }
+  }
+
+  const KernelTable *table_for(RasterKernels::InstructionSet instruction_set) {
+    switch (instruction_set) {
+#ifdef WATERCOHERER_X86_KERNELS
+      case RasterKernels::InstructionSet::SSE2:
+        return &sse2::table;
+      case RasterKernels::InstructionSet::AVX2:
+        return &avx2::table;
+      case RasterKernels::InstructionSet::AVX512:
+        return &avx512::table;
+#endif
+      default:
+        return &scalar::table;
+    }
+  }
+
+  std::atomic<const KernelTable *> &active_table() {
+    static std::atomic<const KernelTable *> table{
+      table_for(RasterKernels::best_instruction_set())};
+    return table;
+  }
+
+  const KernelTable &kernels() {
+    return *active_table().load(std::memory_order_relaxed);
+  }
+}
+
+RasterKernels::InstructionSet RasterKernels::best_instruction_set() {
+  for (auto instruction_set : {InstructionSet::AVX512, InstructionSet::AVX2,
+                               InstructionSet::SSE2}) {
+    if (supported(instruction_set)) {
+      return instruction_set;
+    }
+  }
+  return InstructionSet::Scalar;
+}
+
+RasterKernels::InstructionSet RasterKernels::instruction_set() {
+  return kernels().instruction_set;
+}
+
+bool RasterKernels::use_instruction_set(InstructionSet instruction_set) {
+  if (!supported(instruction_set)) {
+    return false;
+  }
+  active_table().store(table_for(instruction_set), std::memory_order_relaxed);
+  return true;
+}
+
+void RasterKernels::threshold_above(const unsigned char *values, unsigned int width,
+                                    unsigned char threshold, Word *words) {
+  kernels().threshold_above(values, width, threshold, words);
+}
+
+void RasterKernels::lookup_two_band(const unsigned char *table, const unsigned char *first,
+                                    const unsigned char *second, unsigned int width,
+                                    Word *words) {
+  kernels().lookup_two_band(table, first, second, width, words);
+}
+
+void RasterKernels::unite(Word *words, const Word *other, std::size_t size) {
+  kernels().unite(words, other, size);
+}
+
+void RasterKernels::subtract(Word *words, const Word *omitted, std::size_t size) {
+  kernels().subtract(words, omitted, size);
+}
+
+void RasterKernels::expand(const Word *words, unsigned int width, unsigned char *pixels) {
+  kernels().expand(words, width, pixels);
+}
+
+void RasterKernels::split_water_types(const Word *water, const unsigned char *nir,
+                                      unsigned int width, unsigned char threshold,
+                                      unsigned char *bright, unsigned char *dark) {
+  const KernelTable &table = kernels();
+  for (unsigned int x = 0; x < width; x += word_bits) {
+    unsigned int size = std::min(word_bits, width - x);
+    Word bright_words[1];
+    table.threshold_above(nir + x, size, threshold, bright_words);
+    Word water_word = water[x / word_bits];
+    Word bright_word = water_word & bright_words[0];
+    Word dark_word = water_word & ~bright_words[0];
+    table.expand(&bright_word, size, bright + x);
+    table.expand(&dark_word, size, dark + x);
+  }
+}
@@ -0,0 +1,103 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "RasterPartitioner.hpp"
+#include "NumaTopology.hpp"
+#include "PixelMask.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+using namespace WaterCoherer;
+
+RasterPartitioner::RasterPartitioner(unsigned int width, unsigned int height,
+                                     unsigned int tile_width, unsigned int tile_height)
+  : width_(width), height_(height) {
+  // Rounded up to whole mask words, see the class comment.
+  tile_width = std::max(tile_width, 1u);
+  tile_width_ = (tile_width + PixelMask::word_bits - 1) / PixelMask::word_bits *
+                PixelMask::word_bits;
+  tile_height_ = std::max(tile_height, 1u);
+  tiles_x_ = (width_ + tile_width_ - 1) / tile_width_;
+  tiles_y_ = (height_ + tile_height_ - 1) / tile_height_;
+
+  node_count_ = NumaTopology::instance().node_count();
+  ranges_.reset(new NodeRange[node_count_]);
+  for (unsigned int node = 0; node < node_count_; ++node) {
+    ranges_[node].next = tiles_y_ * node / node_count_ * tiles_x_;
+    ranges_[node].end = tiles_y_ * (node + 1) / node_count_ * tiles_x_;
+  }
+}
+
+unsigned int RasterPartitioner::tiles_x() const {
+  return tiles_x_;
+}
+
+unsigned int RasterPartitioner::tiles_y() const {
+  return tiles_y_;
+}
+
+unsigned int RasterPartitioner::tile_count() const {
+  return tiles_x_ * tiles_y_;
+}
+
+RasterTile RasterPartitioner::tile(unsigned int index) const {
+  unsigned int tile_x = index % tiles_x_;
+  unsigned int tile_y = index / tiles_x_;
+  return RasterTile{tile_x * tile_width_, std::min(width_, (tile_x + 1) * tile_width_),
+                    tile_y * tile_height_, std::min(height_, (tile_y + 1) * tile_height_)};
+}
+
+bool RasterPartitioner::next(RasterTile &tile) {
+  unsigned int local_node = node_count_ > 1 ? NumaTopology::instance().current_node() : 0;
+  for (unsigned int offset = 0; offset < node_count_; ++offset) {
+    NodeRange &range = ranges_[(local_node + offset) % node_count_];
+    if (range.next.load(std::memory_order_relaxed) >= range.end) {
+      continue;
+    }
+    unsigned int index = range.next.fetch_add(1, std::memory_order_relaxed);
+    if (index < range.end) {
+      tile = this->tile(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+void RasterPartitioner::run(unsigned int cores,
+                            const std::function<void(const RasterTile &)> &function) {
+  unsigned int workers = std::min(std::max(cores, 1u), tile_count());
+  if (workers <= 1) {
+    RasterTile tile{};
+    while (next(tile)) {
+      function(tile);
+    }
+    return;
+  }
+
+  ThreadPool::instance().parallel_for(workers, [this, &function](unsigned int) {
+    RasterTile tile{};
+    while (next(tile)) {
+      function(tile);
+    }
+  });
+}
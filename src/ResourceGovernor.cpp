@@ -0,0 +1,282 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "ResourceGovernor.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  std::string read_line(const std::string &path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+  }
+
+  bool read_number(const std::string &path, double &value) {
+    std::stringstream line(read_line(path));
+    return static_cast<bool>(line >> value);
+  }
+
+  // Directories of the cgroup controller the process belongs to, the most specific first.
+  // Inside a cgroup namespace the process' own group is the mount root, so the root is tried
+  // as well. A v1 hierarchy with the controller takes precedence over the unified one.
+  std::vector<std::string> cgroup_directories(const std::string &controller) {
+    std::vector<std::string> directories;
+    std::vector<std::string> unified_directories;
+    std::ifstream groups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(groups, line)) {
+      // hierarchy-ID:controller-list:path, with an empty controller list for v2.
+      auto first = line.find(':');
+      auto second = line.find(':', first + 1);
+      if (first == std::string::npos || second == std::string::npos) {
+        continue;
+      }
+      auto controllers = line.substr(first + 1, second - first - 1);
+      auto path = line.substr(second + 1);
+      std::string group = path.empty() || path == "/" ? "" : path;
+      if (controllers.empty()) {
+        unified_directories = {"/sys/fs/cgroup" + group, "/sys/fs/cgroup"};
+      } else if (("," + controllers + ",").find("," + controller + ",") != std::string::npos) {
+        directories = {"/sys/fs/cgroup/" + controllers + group, "/sys/fs/cgroup/" + controllers};
+      }
+    }
+    directories.insert(directories.end(), unified_directories.begin(), unified_directories.end());
+    return directories;
+  }
+
+  // Processors allowed by the CPU bandwidth quota, or 0 without a quota.
+  double cpu_quota() {
+    for (const auto &directory : cgroup_directories("cpu")) {
+      double processors = 0.;
+      if (ResourceGovernor::parse_cpu_max(read_line(directory + "/cpu.max"), processors)) {
+        return processors;
+      }
+
+      double quota_us = 0.;
+      double period_us = 0.;
+      if (read_number(directory + "/cpu.cfs_quota_us", quota_us) &&
+          read_number(directory + "/cpu.cfs_period_us", period_us)) {
+        return quota_us <= 0. || period_us <= 0. ? 0. : quota_us / period_us;
+      }
+    }
+    return 0.;
+  }
+
+  // Memory limit of the cgroup, or 0 without a limit.
+  std::size_t cgroup_memory_limit() {
+    for (const auto &directory : cgroup_directories("memory")) {
+      std::size_t bytes = 0;
+      if (ResourceGovernor::parse_memory_max(read_line(directory + "/memory.max"), bytes)) {
+        return bytes;
+      }
+      double limit = 0.;
+      if (read_number(directory + "/memory.limit_in_bytes", limit)) {
+        // Without a limit, v1 reports a value close to the largest 64-bit number.
+        return limit >= static_cast<double>(std::numeric_limits<int64_t>::max() / 2) ? 0 :
+               static_cast<std::size_t>(limit);
+      }
+    }
+    return 0;
+  }
+
+  unsigned int allowed_processors() {
+    unsigned int processors = std::max(std::thread::hardware_concurrency(), 1u);
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+      processors = std::min(processors, static_cast<unsigned int>(CPU_COUNT(&set)));
+    }
+    double quota = cpu_quota();
+    if (quota > 0.) {
+      processors = std::min(processors, static_cast<unsigned int>(std::ceil(quota)));
+    }
+    return std::max(processors, 1u);
+  }
+
+  std::size_t available_memory() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGE_SIZE);
+    std::size_t physical = pages > 0 && page_size > 0 ?
+                           static_cast<std::size_t>(pages) * static_cast<std::size_t>(page_size) :
+                           std::numeric_limits<std::size_t>::max();
+    std::size_t limit = cgroup_memory_limit();
+    return limit > 0 ? std::min(limit, physical) : physical;
+  }
+}
+
+SceneSlots::SceneSlots(std::size_t slots) : available_(std::max<std::size_t>(slots, 1)) {
+}
+
+bool SceneSlots::try_acquire() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (available_ == 0) {
+    return false;
+  }
+  --available_;
+  return true;
+}
+
+void SceneSlots::acquire() {
+  while (!try_acquire()) {
+    // Queued tasks may be what frees a slot, e.g. the classification of a loaded scene, so
+    // they are run first; with none left the thread sleeps until release() notifies it.
+    if (ThreadPool::instance().run_pending_task()) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this]() { return available_ > 0; });
+  }
+}
+
+void SceneSlots::release() {
+  std::coroutine_handle<> waiting;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (waiting_coroutines_.empty()) {
+      ++available_;
+    } else {
+      waiting = waiting_coroutines_.front();
+      waiting_coroutines_.pop_front();
+    }
+  }
+  if (waiting) {
+    ThreadPool::instance().submit([waiting]() { waiting.resume(); });
+  } else {
+    released_.notify_one();
+  }
+}
+
+bool SceneSlots::Awaiter::await_suspend(std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> guard(slots.mutex_);
+  if (slots.available_ > 0) {
+    --slots.available_;
+    return false;
+  }
+  slots.waiting_coroutines_.push_back(handle);
+  return true;
+}
+
+SceneSlot::SceneSlot(SceneSlots &slots) : slots_(&slots) {
+  slots.acquire();
+}
+
+SceneSlot::SceneSlot(SceneSlot &&other) noexcept : slots_(other.slots_) {
+  other.slots_ = nullptr;
+}
+
+SceneSlot &SceneSlot::operator=(SceneSlot &&other) noexcept {
+  if (this != &other) {
+    release();
+    slots_ = other.slots_;
+    other.slots_ = nullptr;
+  }
+  return *this;
+}
+
+SceneSlot::~SceneSlot() {
+  release();
+}
+
+void SceneSlot::release() {
+  if (slots_) {
+    slots_->release();
+    slots_ = nullptr;
+  }
+}
+
+ResourceGovernor::ResourceGovernor(unsigned int processors, std::size_t memory_limit)
+  : processors_(processors), memory_limit_(memory_limit), scene_slots_(max_scenes_in_memory()) {
+}
+
+ResourceGovernor &ResourceGovernor::instance() {
+  static ResourceGovernor governor(allowed_processors(), available_memory());
+  return governor;
+}
+
+unsigned int ResourceGovernor::processors() const {
+  return processors_;
+}
+
+std::size_t ResourceGovernor::memory_limit() const {
+  return memory_limit_;
+}
+
+std::size_t ResourceGovernor::max_scenes_in_memory() const {
+  return std::max<std::size_t>(memory_limit_ / 4 * 3 / scene_bytes, 1);
+}
+
+SceneSlots &ResourceGovernor::scene_slots() {
+  return scene_slots_;
+}
+
+bool ResourceGovernor::parse_cpu_max(const std::string &contents, double &processors) {
+  std::stringstream maximum(contents);
+  std::string quota;
+  double period = 0.;
+  if (!(maximum >> quota >> period)) {
+    return false;
+  }
+  if (quota == "max" || period <= 0.) {
+    processors = 0.;
+    return true;
+  }
+  std::stringstream quota_number(quota);
+  double quota_us = 0.;
+  if (!(quota_number >> quota_us)) {
+    return false;
+  }
+  processors = quota_us <= 0. ? 0. : quota_us / period;
+  return true;
+}
+
+bool ResourceGovernor::parse_memory_max(const std::string &contents, std::size_t &bytes) {
+  std::stringstream maximum(contents);
+  std::string limit;
+  if (!(maximum >> limit)) {
+    return false;
+  }
+  if (limit == "max") {
+    bytes = 0;
+    return true;
+  }
+  // Stream extraction would wrap negative numbers around, so only digits are accepted.
+  if (limit.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  bytes = static_cast<std::size_t>(std::strtoull(limit.c_str(), nullptr, 10));
+  return true;
+}
@@ -0,0 +1,254 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "RunLengthMask.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Returns the first x >= start whose bit equals value, or width when there is none.
+  unsigned int find_next(const PixelMask::Word *words, unsigned int width, unsigned int start,
+                         bool value) {
+    unsigned int x = start;
+    while (x < width) {
+      PixelMask::Word word = words[x / PixelMask::word_bits];
+      if (!value) {
+        word = ~word;
+      }
+      word >>= x % PixelMask::word_bits;
+      if (word) {
+        return std::min(width, x + static_cast<unsigned int>(__builtin_ctzll(word)));
+      }
+      x = (x / PixelMask::word_bits + 1) * PixelMask::word_bits;
+    }
+    return width;
+  }
+
+  void fill_bits(PixelMask::Word *words, unsigned int begin, unsigned int end) {
+    while (begin < end) {
+      unsigned int offset = begin % PixelMask::word_bits;
+      unsigned int length = std::min(end - begin, PixelMask::word_bits - offset);
+      PixelMask::Word bits = length == PixelMask::word_bits ? ~PixelMask::Word{0} :
+                             ((PixelMask::Word{1} << length) - 1) << offset;
+      words[begin / PixelMask::word_bits] |= bits;
+      begin += length;
+    }
+  }
+}
+
+RunLengthMask::RunLengthMask(unsigned int width, unsigned int height) :
+  width_(width), height_(height), row_offsets_(height + 1, 0) {
+}
+
+void RunLengthMask::push_back_run(unsigned int begin, unsigned int end) {
+  std::size_t row_start = row_offsets_.back();
+  if (runs_.size() > row_start && runs_.back().end >= begin) {
+    runs_.back().end = std::max(runs_.back().end, end);
+    return;
+  }
+  runs_.push_back({begin, end});
+}
+
+void RunLengthMask::finish_row() {
+  row_offsets_.push_back(runs_.size());
+}
+
+RunLengthMask RunLengthMask::from_layer(const TiffImage &image_layer) {
+  RunLengthMask result;
+  result.width_ = static_cast<unsigned int>(image_layer.width());
+  result.height_ = static_cast<unsigned int>(image_layer.height());
+  result.row_offsets_.push_back(0);
+  for (unsigned int y = 0; y < result.height_; ++y) {
+    const unsigned char *pixels = image_layer.data(0, y);
+    unsigned int x = 0;
+    while (x < result.width_) {
+      while (x < result.width_ && !pixels[x]) {
+        ++x;
+      }
+      unsigned int begin = x;
+      while (x < result.width_ && pixels[x]) {
+        ++x;
+      }
+      if (begin < x) {
+        result.push_back_run(begin, x);
+      }
+    }
+    result.finish_row();
+  }
+  return result;
+}
+
+RunLengthMask RunLengthMask::from_pixel_mask(const PixelMask &pixel_mask) {
+  RunLengthMask result;
+  result.width_ = pixel_mask.width();
+  result.height_ = pixel_mask.height();
+  result.row_offsets_.push_back(0);
+  for (unsigned int y = 0; y < result.height_; ++y) {
+    const PixelMask::Word *words = pixel_mask.row(y);
+    unsigned int x = find_next(words, result.width_, 0, true);
+    while (x < result.width_) {
+      unsigned int end = find_next(words, result.width_, x, false);
+      result.push_back_run(x, end);
+      x = find_next(words, result.width_, end, true);
+    }
+    result.finish_row();
+  }
+  return result;
+}
+
+PixelMask RunLengthMask::to_pixel_mask() const {
+  PixelMask result(width_, height_);
+  for (unsigned int y = 0; y < height_; ++y) {
+    PixelMask::Word *words = result.row(y);
+    for (auto run = row_begin(y); run != row_end(y); ++run) {
+      fill_bits(words, run->begin, run->end);
+    }
+  }
+  return result;
+}
+
+unsigned int RunLengthMask::width() const {
+  return width_;
+}
+
+unsigned int RunLengthMask::height() const {
+  return height_;
+}
+
+std::size_t RunLengthMask::count() const {
+  std::size_t result = 0;
+  for (const auto &run : runs_) {
+    result += run.end - run.begin;
+  }
+  return result;
+}
+
+std::size_t RunLengthMask::run_count() const {
+  return runs_.size();
+}
+
+bool RunLengthMask::same_size(const RunLengthMask &other) const {
+  return width_ == other.width_ && height_ == other.height_;
+}
+
+bool RunLengthMask::empty() const {
+  return row_offsets_.empty();
+}
+
+RunLengthMask RunLengthMask::unite(const RunLengthMask &first, const RunLengthMask &second) {
+  if (first.empty()) {
+    return second;
+  }
+  if (second.empty()) {
+    return first;
+  }
+  if (!first.same_size(second)) {
+    std::cerr << "WARNING WaterCoherer: Omitted run length mask of different size." << std::endl;
+    return first;
+  }
+
+  RunLengthMask result;
+  result.width_ = first.width_;
+  result.height_ = first.height_;
+  result.runs_.reserve(std::max(first.runs_.size(), second.runs_.size()));
+  result.row_offsets_.push_back(0);
+  for (unsigned int y = 0; y < result.height_; ++y) {
+    auto a = first.row_begin(y);
+    auto b = second.row_begin(y);
+    while (a != first.row_end(y) || b != second.row_end(y)) {
+      if (b == second.row_end(y) || (a != first.row_end(y) && a->begin <= b->begin)) {
+        result.push_back_run(a->begin, a->end);
+        ++a;
+      } else {
+        result.push_back_run(b->begin, b->end);
+        ++b;
+      }
+    }
+    result.finish_row();
+  }
+  return result;
+}
+
+RunLengthMask RunLengthMask::intersect(const RunLengthMask &first, const RunLengthMask &second) {
+  if (!first.same_size(second)) {
+    std::cerr << "WARNING WaterCoherer: Omitted run length mask of different size." << std::endl;
+    return first;
+  }
+
+  RunLengthMask result;
+  result.width_ = first.width_;
+  result.height_ = first.height_;
+  result.row_offsets_.push_back(0);
+  for (unsigned int y = 0; y < result.height_; ++y) {
+    auto a = first.row_begin(y);
+    auto b = second.row_begin(y);
+    while (a != first.row_end(y) && b != second.row_end(y)) {
+      unsigned int begin = std::max(a->begin, b->begin);
+      unsigned int end = std::min(a->end, b->end);
+      if (begin < end) {
+        result.push_back_run(begin, end);
+      }
+      if (a->end < b->end) {
+        ++a;
+      } else {
+        ++b;
+      }
+    }
+    result.finish_row();
+  }
+  return result;
+}
+
+RunLengthMask RunLengthMask::subtract(const RunLengthMask &first, const RunLengthMask &second) {
+  if (!first.same_size(second)) {
+    std::cerr << "WARNING WaterCoherer: Omitted run length mask of different size." << std::endl;
+    return first;
+  }
+
+  RunLengthMask result;
+  result.width_ = first.width_;
+  result.height_ = first.height_;
+  result.row_offsets_.push_back(0);
+  for (unsigned int y = 0; y < result.height_; ++y) {
+    auto b = second.row_begin(y);
+    for (auto a = first.row_begin(y); a != first.row_end(y); ++a) {
+      unsigned int begin = a->begin;
+      while (b != second.row_end(y) && b->end <= begin) {
+        ++b;
+      }
+      for (auto cut = b; cut != second.row_end(y) && cut->begin < a->end; ++cut) {
+        if (begin < cut->begin) {
+          result.push_back_run(begin, cut->begin);
+        }
+        begin = std::max(begin, cut->end);
+      }
+      if (begin < a->end) {
+        result.push_back_run(begin, a->end);
+      }
+    }
+    result.finish_row();
+  }
+  return result;
+}
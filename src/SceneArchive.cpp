@@ -0,0 +1,225 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "SceneArchive.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <zlib.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  constexpr std::size_t block_size = 512;
+  using Block = std::array<unsigned char, block_size>;
+
+  const char *const archive_extensions[] = {".tar.gz", ".tgz", ".tar"};
+
+  // Field of a header: at most size characters, up to the first NUL.
+  std::string field(const Block &header, std::size_t offset, std::size_t size) {
+    auto begin = reinterpret_cast<const char *>(header.data()) + offset;
+    return std::string(begin, std::find(begin, begin + size, '\0'));
+  }
+
+  // Octal, or base-256 with the high bit of the first byte set for sizes beyond 8 GiB.
+  uint64_t number(const Block &header, std::size_t offset, std::size_t size) {
+    uint64_t value = 0;
+    if (header[offset] & 0x80) {
+      value = header[offset] & 0x7f;
+      for (std::size_t i = offset + 1; i < offset + size; ++i) {
+        value = value << 8 | header[i];
+      }
+      return value;
+    }
+    for (std::size_t i = offset; i < offset + size; ++i) {
+      if (header[i] >= '0' && header[i] <= '7') {
+        value = value << 3 | (header[i] - '0');
+      } else if (header[i] != ' ' || value != 0) {
+        break;
+      }
+    }
+    return value;
+  }
+
+  // The checksum is taken over the header with its own field counted as spaces.
+  bool valid_header(const Block &header) {
+    uint64_t sum = 0;
+    for (std::size_t i = 0; i < block_size; ++i) {
+      sum += i >= 148 && i < 156 ? ' ' : header[i];
+    }
+    return sum == number(header, 148, 8);
+  }
+
+  bool end_of_archive(const Block &header) {
+    return std::all_of(header.begin(), header.end(), [](unsigned char byte) {
+      return byte == 0;
+    });
+  }
+
+  // The path of a pax extended header: records of "<length> <key>=<value>\n".
+  std::string pax_path(const std::vector<unsigned char> &records) {
+    std::string text(records.begin(), records.end());
+    std::size_t position = 0;
+    while (position < text.size()) {
+      std::size_t length = std::strtoul(text.c_str() + position, nullptr, 10);
+      std::size_t space = text.find(' ', position);
+      if (0 == length || space == std::string::npos || position + length > text.size()) {
+        break;
+      }
+      auto record = text.substr(space + 1, position + length - space - 2);
+      if (record.compare(0, 5, "path=") == 0) {
+        return record.substr(5);
+      }
+      position += length;
+    }
+    return std::string();
+  }
+
+  std::string file_name(const std::string &member_path) {
+    auto separator = member_path.find_last_of('/');
+    return separator == std::string::npos ? member_path : member_path.substr(separator + 1);
+  }
+
+  // gzread passes plain tar archives through as they are, so both kinds are read alike.
+  bool read_bytes(gzFile archive, unsigned char *destination, uint64_t size) {
+    while (size > 0) {
+      auto chunk = static_cast<unsigned int>(std::min<uint64_t>(size, 1u << 30));
+      int count = gzread(archive, destination, chunk);
+      if (count <= 0) {
+        return false;
+      }
+      destination += count;
+      size -= count;
+    }
+    return true;
+  }
+
+  bool skip_bytes(gzFile archive, uint64_t size) {
+    return size == 0 || gzseek(archive, static_cast<z_off_t>(size), SEEK_CUR) >= 0;
+  }
+
+  uint64_t padding(uint64_t size) {
+    return (block_size - size % block_size) % block_size;
+  }
+}
+
+bool SceneArchive::is_archive(const std::string &path) {
+  return std::any_of(std::begin(archive_extensions), std::end(archive_extensions),
+                     [&path](const char *extension) { return path.ends_with(extension); });
+}
+
+std::string SceneArchive::scene_name(const std::string &path) {
+  auto name = path;
+  while (name.size() > 1 && name.back() == '/') {
+    name.pop_back();
+  }
+  name = file_name(name);
+  for (auto extension : archive_extensions) {
+    if (name.ends_with(extension)) {
+      return name.substr(0, name.size() - std::char_traits<char>::length(extension));
+    }
+  }
+  return name;
+}
+
+bool SceneArchive::read_members(
+    const std::string &path, const std::function<bool(const std::string &)> &wanted,
+    const std::function<void(const std::string &, std::vector<unsigned char>)> &read) {
+  gzFile archive = gzopen(path.c_str(), "rb");
+  if (nullptr == archive) {
+    std::cerr << "WARNING WaterCoherer: Could not open input archive:\n" << "\t" + path
+              << std::endl;
+    return false;
+  }
+  // Members are megabytes long; a large buffer keeps inflate off the small read path.
+  gzbuffer(archive, 1u << 20);
+
+  bool complete = false;
+  std::string long_name;
+  Block header;
+  while (true) {
+    // Some writers leave out the end blocks, so an archive may also end between members.
+    int count = gzread(archive, header.data(), block_size);
+    if (0 == count && gzeof(archive)) {
+      complete = true;
+      break;
+    }
+    if (count != static_cast<int>(block_size)) {
+      break;
+    }
+    if (end_of_archive(header)) {
+      complete = true;
+      break;
+    }
+    if (!valid_header(header)) {
+      break;
+    }
+    auto size = number(header, 124, 12);
+    char type = static_cast<char>(header[156]);
+    auto member_path = field(header, 0, 100);
+    auto prefix = field(header, 345, 155);
+    if (field(header, 257, 5) == "ustar" && !prefix.empty()) {
+      member_path = prefix + "/" + member_path;
+    }
+
+    // GNU long names and pax headers name the member following them.
+    if (type == 'L' || type == 'x') {
+      std::vector<unsigned char> data(size);
+      if (!read_bytes(archive, data.data(), size) || !skip_bytes(archive, padding(size))) {
+        break;
+      }
+      long_name = type == 'L' ? std::string(data.begin(), std::find(data.begin(), data.end(), 0))
+                              : pax_path(data);
+      continue;
+    }
+    if (!long_name.empty()) {
+      member_path = std::move(long_name);
+      long_name.clear();
+    }
+
+    auto name = file_name(member_path);
+    bool regular_file = type == '0' || type == '\0' || type == '7';
+    if (regular_file && !name.empty() && wanted(name)) {
+      std::vector<unsigned char> data(size);
+      if (!read_bytes(archive, data.data(), size) || !skip_bytes(archive, padding(size))) {
+        break;
+      }
+      read(name, std::move(data));
+    } else if (!skip_bytes(archive, size + padding(size))) {
+      break;
+    }
+  }
+  gzclose(archive);
+
+  if (!complete) {
+    std::cerr << "WARNING WaterCoherer: Input archive is damaged or truncated:\n" << "\t" + path
+              << std::endl;
+  }
+  return complete;
+}
@@ -0,0 +1,78 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "SceneClassifier.hpp"
+#include "NDWICalculator.hpp"
+#include "RasterKernels.hpp"
+#include "RasterPartitioner.hpp"
+
+#include <iostream>
+#include <vector>
+
+using namespace WaterCoherer;
+
+SceneClassification SceneClassifier::classify(unsigned int cores, const TiffImage &blue_layer,
+                                              const TiffImage &green_layer,
+                                              const TiffImage &nir_layer) {
+  return classify(cores, blue_layer, green_layer, nir_layer,
+                  NDWICalculator::lookup_table(NDWICalculator::Method::GreenNir));
+}
+
+SceneClassification SceneClassifier::classify(unsigned int cores, const TiffImage &blue_layer,
+                                              const TiffImage &green_layer,
+                                              const TiffImage &nir_layer,
+                                              const TwoBandLookupTable &water_classification) {
+  auto width = static_cast<unsigned int>(blue_layer.width());
+  auto height = static_cast<unsigned int>(blue_layer.height());
+  SceneClassification result{PixelMask(width, height), PixelMask(width, height),
+                             PixelMask(width, height)};
+  if (green_layer.width() != blue_layer.width() || green_layer.height() != blue_layer.height() ||
+      nir_layer.width() != blue_layer.width() || nir_layer.height() != blue_layer.height()) {
+    std::cerr << "Scene Classifier: Layers of the scene differ in size!" << std::endl;
+    return result;
+  }
+
+  RasterPartitioner partitioner(width, height);
+  partitioner.run(cores, [&result, &blue_layer, &green_layer, &nir_layer,
+                          &water_classification](const RasterTile &tile) {
+    std::size_t word_begin = tile.x_begin / PixelMask::word_bits;
+    std::size_t word_count = PixelMask::words_for_width(tile.width());
+
+    for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+      const unsigned char *nir = nir_layer.data(tile.x_begin, y);
+      PixelMask::Word *water = result.water.row(y) + word_begin;
+      PixelMask::Word *bright_water = result.bright_water.row(y) + word_begin;
+
+      RasterKernels::threshold_above(blue_layer.data(tile.x_begin, y), tile.width(), 120,
+                                     result.clouds.row(y) + word_begin);
+      water_classification.classify_row(green_layer.data(tile.x_begin, y), nir, tile.width(),
+                                        water);
+      // Near infrared value of at least 17, as used by WaterDifferencer.
+      RasterKernels::threshold_above(nir, tile.width(), 16, bright_water);
+      for (std::size_t w = 0; w < word_count; ++w) {
+        bright_water[w] &= water[w];
+      }
+    }
+  });
+  return result;
+}
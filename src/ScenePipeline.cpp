@@ -0,0 +1,172 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "ScenePipeline.hpp"
+#include "BoundedQueue.hpp"
+#include "CloudDetection.hpp"
+#include "CogWriter.hpp"
+#include "LandsatImage.hpp"
+#include "NDWICalculator.hpp"
+#include "ResourceGovernor.hpp"
+#include "SceneArchive.hpp"
+#include "ThreadPool.hpp"
+
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using namespace WaterCoherer;
+
+namespace {
+  struct LoadedScene {
+    std::string name;
+    std::unique_ptr<LandsatImage> image;
+    SceneSlot slot;
+  };
+
+  struct ClassifiedScene {
+    std::string name;
+    GeoReference georeference;
+    PixelMask clouds;
+    PixelMask water;
+  };
+}
+
+ScenePipeline::ScenePipeline(unsigned int cores, std::size_t queue_capacity)
+  : cores_(cores), queue_capacity_(queue_capacity) {
+}
+
+void ScenePipeline::restrict_to(const PixelWindow &window) {
+  window_ = window;
+  bounding_box_.reset();
+}
+
+void ScenePipeline::restrict_to(const MapBoundingBox &bounding_box) {
+  bounding_box_ = bounding_box;
+  window_.reset();
+}
+
+void ScenePipeline::run(const std::vector<std::string> &scene_directories,
+                        const std::string &output_directory) {
+  BoundedQueue<LoadedScene> loaded_scenes(queue_capacity_);
+  BoundedQueue<ClassifiedScene> classified_scenes(queue_capacity_);
+  std::mutex error_mutex;
+  std::exception_ptr error;
+
+  // A failing stage closes both queues, which releases the stages waiting on either side.
+  auto fail = [&error_mutex, &error, &loaded_scenes, &classified_scenes]() {
+    {
+      std::lock_guard<std::mutex> guard(error_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+    loaded_scenes.close();
+    classified_scenes.close();
+  };
+
+  // Stages block on their queues, so they run on their own threads and leave the shared pool
+  // to the kernels they call.
+  std::thread loading([this, &scene_directories, &loaded_scenes, &fail]() {
+    try {
+      for (const auto &directory : scene_directories) {
+        LoadedScene scene{SceneArchive::scene_name(directory),
+                          std::unique_ptr<LandsatImage>(new LandsatImage()),
+                          SceneSlot(ResourceGovernor::instance().scene_slots())};
+        if (window_) {
+          scene.image->load_image(directory.c_str(), *window_);
+        } else if (bounding_box_) {
+          scene.image->load_image(directory.c_str(), *bounding_box_);
+        } else {
+          scene.image->load_image(directory.c_str());
+        }
+        // Scenes that could not be read, e.g. from a damaged archive, were warned about while
+        // loading and are left out of the batch.
+        if (0 == scene.image->width()) {
+          continue;
+        }
+        // Decoding belongs to this stage; the bands classification does not view stay encoded.
+        scene.image->prefetch({LandsatImage::Band::Blue, LandsatImage::Band::Green,
+                               LandsatImage::Band::NearInfrared});
+        if (!loaded_scenes.push(std::move(scene))) {
+          break;
+        }
+      }
+      loaded_scenes.close();
+    } catch (...) {
+      fail();
+    }
+  });
+
+  std::thread classification([this, &loaded_scenes, &classified_scenes, &fail]() {
+    try {
+      LoadedScene scene;
+      while (loaded_scenes.pop(scene)) {
+        auto clouds = CloudDetection::localize_clouds(scene.image->view_blue_layer(), cores_);
+        auto water = NDWICalculator::localize_water(cores_, scene.image->view_green_layer(),
+                                                    scene.image->view_nir_layer(), clouds);
+        auto georeference = scene.image->georeference();
+        // The bands are released before waiting for room in the output queue.
+        scene.image.reset();
+        scene.slot.release();
+        if (!classified_scenes.push({std::move(scene.name), std::move(georeference),
+                                     std::move(clouds), std::move(water)})) {
+          break;
+        }
+      }
+      classified_scenes.close();
+    } catch (...) {
+      fail();
+    }
+  });
+
+  try {
+    ClassifiedScene scene;
+    while (classified_scenes.pop(scene)) {
+      // Both layers are encoded at the same time; each of them splits into strips further.
+      auto prefix = output_directory + "/" + scene.name;
+      TaskGroup writing;
+      writing.run([this, &scene, &prefix]() {
+        CogWriter::save(scene.water, prefix + "_water.tif", cores_,
+                        scene.georeference);
+      });
+      writing.run([this, &scene, &prefix]() {
+        CogWriter::save(scene.clouds, prefix + "_clouds.tif", cores_,
+                        scene.georeference);
+      });
+      writing.wait();
+      std::cout << "INFO Water Coherer: Written " + scene.name + " with " +
+                   std::to_string(scene.water.count()) + " pixels of water.\n" << std::flush;
+    }
+  } catch (...) {
+    fail();
+  }
+
+  loading.join();
+  classification.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
@@ -0,0 +1,119 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "StreamingClassifier.hpp"
+#include "CloudDetection.hpp"
+#include "GeoReference.hpp"
+#include "LandsatImage.hpp"
+#include "NDWICalculator.hpp"
+#include "SceneArchive.hpp"
+#include "ThreadPool.hpp"
+#include "TiffReader.hpp"
+#include "TiffWriter.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace WaterCoherer;
+
+namespace {
+  // The bands are read at the same time, each through its own reader.
+  bool read_chunk(const std::vector<TiffStripReader *> &readers, unsigned int row,
+                  unsigned int rows, std::vector<TiffImage> &chunks) {
+    std::vector<char> read(readers.size(), 0);
+    TaskGroup reading;
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+      reading.run([i, row, rows, &readers, &chunks, &read]() {
+        read[i] = readers[i]->read_rows(row, rows, chunks[i]);
+      });
+    }
+    reading.wait();
+    return std::all_of(read.begin(), read.end(), [](char value) { return value != 0; });
+  }
+}
+
+bool StreamingClassifier::classify(const std::string &scene_directory,
+                                   const std::string &output_directory, unsigned int cores) {
+  // An archive yields its members only whole and in its own order, not strip by strip.
+  if (SceneArchive::is_archive(scene_directory)) {
+    std::cerr << "WARNING WaterCoherer: Archived scenes cannot be streamed:\n" << "\t" +
+              scene_directory << std::endl;
+    return false;
+  }
+  // Loading only indexes the band files; none of them is decoded.
+  LandsatImage scene;
+  scene.load_image(scene_directory.c_str());
+  auto prefix = output_directory + "/" + SceneArchive::scene_name(scene_directory);
+  return classify(scene.band_path(LandsatImage::Band::Blue),
+                  scene.band_path(LandsatImage::Band::Green),
+                  scene.band_path(LandsatImage::Band::NearInfrared), prefix + "_water.tif",
+                  prefix + "_clouds.tif", cores);
+}
+
+bool StreamingClassifier::classify(const std::string &blue_path, const std::string &green_path,
+                                   const std::string &nir_path, const std::string &water_path,
+                                   const std::string &clouds_path, unsigned int cores) {
+  TiffStripReader blue(blue_path);
+  TiffStripReader green(green_path);
+  TiffStripReader nir(nir_path);
+  if (!blue.is_open() || !green.is_open() || !nir.is_open() ||
+      blue.width() != green.width() || blue.height() != green.height() ||
+      nir.width() != green.width() || nir.height() != green.height()) {
+    std::cerr << "WARNING WaterCoherer: Bands cannot be streamed together:\n" << "\t" +
+              green_path << std::endl;
+    return false;
+  }
+
+  unsigned int width = green.width();
+  unsigned int height = green.height();
+  auto georeference = GeoReference::read(green_path);
+  TiffStripWriter water(water_path, width, height, georeference);
+  TiffStripWriter clouds(clouds_path, width, height, georeference);
+  if (!water.is_open() || !clouds.is_open()) {
+    return false;
+  }
+
+  // Every chunk decodes each band's strips once, and being whole strips of the outputs it passes
+  // straight through the writers without being buffered.
+  std::vector<TiffStripReader *> readers = {&blue, &green, &nir};
+  unsigned int input_rows = 1;
+  for (auto reader : readers) {
+    input_rows = std::max(input_rows, reader->rows_per_strip());
+  }
+  unsigned int output_rows = water.rows_per_strip();
+  unsigned int rows_per_chunk = (input_rows + output_rows - 1) / output_rows * output_rows;
+  std::vector<TiffImage> chunks(readers.size());
+  for (unsigned int row = 0; row < height; row += rows_per_chunk) {
+    unsigned int rows = std::min(rows_per_chunk, height - row);
+    if (!read_chunk(readers, row, rows, chunks)) {
+      return false;
+    }
+    auto cloud_mask = CloudDetection::localize_clouds(chunks[0], cores);
+    auto water_mask = NDWICalculator::localize_water(cores, chunks[1], chunks[2], cloud_mask);
+    if (!clouds.write_rows(cloud_mask, cores) || !water.write_rows(water_mask, cores)) {
+      return false;
+    }
+  }
+  bool clouds_written = clouds.close();
+  return water.close() && clouds_written;
+}
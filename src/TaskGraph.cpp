@@ -0,0 +1,82 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "TaskGraph.hpp"
+
+#include <iostream>
+#include <utility>
+
+using namespace WaterCoherer;
+
+TaskGraph::TaskGraph(ThreadPool &pool) : pool_(pool) {
+}
+
+TaskGraph::Node TaskGraph::add(ThreadPool::Task function,
+                               std::initializer_list<Node> dependencies) {
+  return add(std::move(function), std::vector<Node>(dependencies));
+}
+
+TaskGraph::Node TaskGraph::add(ThreadPool::Task function, const std::vector<Node> &dependencies) {
+  Node node = tasks_.size();
+  tasks_.emplace_back(new Task());
+  tasks_.back()->function = std::move(function);
+  for (Node dependency : dependencies) {
+    if (dependency >= node) {
+      std::cerr << "WARNING Task Graph: Dependency on a task added later is ignored!" << std::endl;
+      continue;
+    }
+    tasks_[dependency]->dependents.push_back(node);
+    ++tasks_.back()->dependencies;
+  }
+  return node;
+}
+
+std::size_t TaskGraph::size() const {
+  return tasks_.size();
+}
+
+void TaskGraph::schedule(TaskGroup &group, Node node) {
+  group.run([this, &group, node]() {
+    Task &task = *tasks_[node];
+    task.function();
+    // Only reached when the task succeeded; dependents of a failed task are never queued.
+    for (Node dependent : task.dependents) {
+      if (--tasks_[dependent]->remaining == 0) {
+        schedule(group, dependent);
+      }
+    }
+  });
+}
+
+void TaskGraph::run() {
+  for (auto &task : tasks_) {
+    task->remaining = task->dependencies;
+  }
+
+  TaskGroup group(pool_);
+  for (Node node = 0; node < tasks_.size(); ++node) {
+    if (tasks_[node]->dependencies == 0) {
+      schedule(group, node);
+    }
+  }
+  group.wait();
+}
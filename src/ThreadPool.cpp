@@ -0,0 +1,207 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "ThreadPool.hpp"
+#include "NumaTopology.hpp"
+#include "ResourceGovernor.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Pool and queue index of the worker running on the current thread.
+  thread_local const ThreadPool *current_pool = nullptr;
+  thread_local unsigned int current_queue = 0;
+
+  // Setting WATERCOHERER_PIN_THREADS to anything but 0 pins the shared pool to NUMA nodes.
+  bool pin_threads_requested() {
+    const char *pin_threads = std::getenv("WATERCOHERER_PIN_THREADS");
+    return pin_threads != nullptr && std::strcmp(pin_threads, "0") != 0;
+  }
+}
+
+ThreadPool::ThreadPool(unsigned int workers, bool pin_to_nodes) {
+  workers = workers > 0 ? workers : 1;
+  for (unsigned int i = 0; i < workers; ++i) {
+    queues_.emplace_back(new Queue());
+  }
+  for (unsigned int i = 0; i < workers; ++i) {
+    workers_.emplace_back([this, i, workers, pin_to_nodes]() {
+      if (pin_to_nodes) {
+        // Consecutive workers share a node, so the nodes get equal shares of the pool.
+        const NumaTopology &topology = NumaTopology::instance();
+        NumaTopology::pin_current_thread(
+          topology.node_cpus(i * topology.node_count() / workers));
+      }
+      work(i);
+    });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> guard(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_condition_.notify_all();
+  for (auto &&worker : workers_) {
+    worker.join();
+  }
+}
+
+ThreadPool &ThreadPool::instance() {
+  static ThreadPool pool(ResourceGovernor::instance().processors(), pin_threads_requested());
+  return pool;
+}
+
+unsigned int ThreadPool::size() const {
+  return static_cast<unsigned int>(workers_.size());
+}
+
+void ThreadPool::submit(Task task) {
+  auto index = current_pool == this ? current_queue :
+               static_cast<unsigned int>(next_queue_++ % queues_.size());
+  {
+    // Counted under the queue's lock, so no pop or steal can take the task before it counts.
+    std::lock_guard<std::mutex> guard(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+    ++queued_;
+  }
+  {
+    // A worker checks queued_ under this lock before it sleeps, so it either sees the task or
+    // is already waiting for the notification.
+    std::lock_guard<std::mutex> guard(sleep_mutex_);
+  }
+  sleep_condition_.notify_one();
+}
+
+bool ThreadPool::pop(unsigned int index, Task &task) {
+  std::lock_guard<std::mutex> guard(queues_[index]->mutex);
+  if (queues_[index]->tasks.empty()) {
+    return false;
+  }
+  task = std::move(queues_[index]->tasks.back());
+  queues_[index]->tasks.pop_back();
+  --queued_;
+  return true;
+}
+
+bool ThreadPool::steal(unsigned int thief, Task &task) {
+  for (std::size_t offset = 1; offset <= queues_.size(); ++offset) {
+    auto &queue = *queues_[(thief + offset) % queues_.size()];
+    std::lock_guard<std::mutex> guard(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      --queued_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(unsigned int index) {
+  current_pool = this;
+  current_queue = index;
+  Task task;
+  while (true) {
+    if (pop(index, task) || steal(index, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_condition_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+    if (stop_ && queued_ == 0) {
+      return;
+    }
+  }
+}
+
+bool ThreadPool::run_pending_task() {
+  Task task;
+  bool found = current_pool == this ? pop(current_queue, task) || steal(current_queue, task) :
+               steal(0, task);
+  if (found) {
+    task();
+  }
+  return found;
+}
+
+void ThreadPool::parallel_for(unsigned int count,
+                              const std::function<void(unsigned int)> &function) {
+  TaskGroup group(*this);
+  for (unsigned int i = 0; i < count; ++i) {
+    group.run([i, &function]() { function(i); });
+  }
+  group.wait();
+}
+
+TaskGroup::TaskGroup(ThreadPool &pool) : pool_(pool) {
+}
+
+TaskGroup::~TaskGroup() {
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void TaskGroup::run(ThreadPool::Task task) {
+  ++pending_;
+  pool_.submit([this, task = std::move(task)]() {
+    try {
+      task();
+    } catch (...) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+    // Every finished task wakes the waiters, which then help with tasks queued meanwhile.
+    std::lock_guard<std::mutex> guard(mutex_);
+    --pending_;
+    finished_.notify_all();
+  });
+}
+
+void TaskGroup::wait() {
+  while (pending_ > 0) {
+    if (pool_.run_pending_task()) {
+      continue;
+    }
+    // Remaining tasks are running elsewhere; the next of them to finish wakes this thread.
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t pending = pending_;
+    finished_.wait(lock, [this, pending]() { return pending_ == 0 || pending_ != pending; });
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (error_) {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
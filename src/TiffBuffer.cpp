@@ -0,0 +1,114 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "TiffBuffer.hpp"
+#include "GeoReference.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Position of one handle in the shared bytes.
+  struct Cursor {
+    const std::vector<unsigned char> *bytes;
+    toff_t position;
+  };
+
+  tmsize_t read_bytes(thandle_t handle, void *destination, tmsize_t size) {
+    auto *cursor = static_cast<Cursor *>(handle);
+    toff_t available = cursor->position < cursor->bytes->size()
+                           ? cursor->bytes->size() - cursor->position : 0;
+    auto count = static_cast<tmsize_t>(std::min<toff_t>(available, static_cast<toff_t>(size)));
+    std::memcpy(destination, cursor->bytes->data() + cursor->position, count);
+    cursor->position += count;
+    return count;
+  }
+
+  tmsize_t write_bytes(thandle_t, void *, tmsize_t) {
+    return 0;
+  }
+
+  toff_t seek(thandle_t handle, toff_t offset, int whence) {
+    auto *cursor = static_cast<Cursor *>(handle);
+    switch (whence) {
+      case SEEK_CUR:
+        cursor->position += offset;
+        break;
+      case SEEK_END:
+        cursor->position = cursor->bytes->size() + offset;
+        break;
+      default:
+        cursor->position = offset;
+    }
+    return cursor->position;
+  }
+
+  int close(thandle_t handle) {
+    delete static_cast<Cursor *>(handle);
+    return 0;
+  }
+
+  toff_t size(thandle_t handle) {
+    return static_cast<Cursor *>(handle)->bytes->size();
+  }
+
+  // The bytes serve as the file mapping, so libtiff reads uncompressed strips without copies.
+  int map(thandle_t handle, void **base, toff_t *length) {
+    auto *cursor = static_cast<Cursor *>(handle);
+    *base = const_cast<unsigned char *>(cursor->bytes->data());
+    *length = cursor->bytes->size();
+    return 1;
+  }
+
+  void unmap(thandle_t, void *, toff_t) {
+  }
+}
+
+TiffBuffer::TiffBuffer(std::string name, std::vector<unsigned char> bytes)
+    : name_(std::move(name)), bytes_(std::move(bytes)) {
+}
+
+const std::string &TiffBuffer::name() const {
+  return name_;
+}
+
+const std::vector<unsigned char> &TiffBuffer::bytes() const {
+  return bytes_;
+}
+
+tiff *TiffBuffer::open() const {
+  GeoReference::register_tags();
+  // TIFFClose frees the cursor; a failed open leaves that to the caller, as with file handles.
+  auto *cursor = new Cursor{&bytes_, 0};
+  TIFF *tiff = TIFFClientOpen(name_.c_str(), "r", cursor, read_bytes, write_bytes, seek, close,
+                              size, map, unmap);
+  if (nullptr == tiff) {
+    delete cursor;
+  }
+  return tiff;
+}
@@ -0,0 +1,145 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "TiffCompression.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <zlib.h>
+#ifdef WATERCOHERER_USE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace WaterCoherer;
+
+bool TiffCompression::deflate(const unsigned char *data, std::size_t size,
+                              std::vector<unsigned char> &output) {
+  uLongf compressed_size = compressBound(size);
+  output.resize(compressed_size);
+  if (compress2(output.data(), &compressed_size, data, size, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    return false;
+  }
+  output.resize(compressed_size);
+  return true;
+}
+
+void TiffCompression::lzw(const unsigned char *data, std::size_t size,
+                          std::vector<unsigned char> &output) {
+  constexpr unsigned int clear_code = 256;
+  constexpr unsigned int end_code = 257;
+  constexpr unsigned int first_code = 258;
+  // The table is cleared one code before it would need 13 bits.
+  constexpr unsigned int last_code = 4094;
+  constexpr unsigned int hash_bits = 14;
+  constexpr uint32_t hash_mask = (1U << hash_bits) - 1;
+
+  // Open addressing table of the strings seen so far: prefix code and next byte, plus one so
+  // that zero marks an empty slot.
+  std::vector<uint32_t> keys(std::size_t(1) << hash_bits, 0);
+  std::vector<uint16_t> codes(keys.size());
+  unsigned int next_code = first_code;
+  unsigned int code_bits = 9;
+  uint64_t pending_bits = 0;
+  unsigned int pending_count = 0;
+
+  output.clear();
+  output.reserve(size / 2 + 16);
+  auto put = [&output, &pending_bits, &pending_count, &code_bits](unsigned int code) {
+    pending_bits = (pending_bits << code_bits) | code;
+    pending_count += code_bits;
+    while (pending_count >= 8) {
+      pending_count -= 8;
+      output.push_back(static_cast<unsigned char>(pending_bits >> pending_count));
+    }
+    pending_bits &= (uint64_t(1) << pending_count) - 1;
+  };
+  auto reset = [&keys, &next_code, &code_bits]() {
+    std::fill(keys.begin(), keys.end(), 0);
+    next_code = first_code;
+    code_bits = 9;
+  };
+  // Widens codes once the decoder, which runs one table entry behind, will need it.
+  auto advance = [&put, &reset, &next_code, &code_bits]() {
+    ++next_code;
+    if (next_code == last_code) {
+      put(clear_code);
+      reset();
+    } else if (next_code > (1U << code_bits) - 1) {
+      ++code_bits;
+    }
+  };
+
+  put(clear_code);
+  if (0 == size) {
+    put(end_code);
+  } else {
+    unsigned int prefix = data[0];
+    for (std::size_t i = 1; i < size; ++i) {
+      uint32_t key = ((prefix << 8) | data[i]) + 1;
+      uint32_t slot = (key * 2654435761U) >> (32 - hash_bits);
+      while (keys[slot] != 0 && keys[slot] != key) {
+        slot = (slot + 1) & hash_mask;
+      }
+      if (keys[slot] == key) {
+        prefix = codes[slot];
+        continue;
+      }
+      put(prefix);
+      keys[slot] = key;
+      codes[slot] = static_cast<uint16_t>(next_code);
+      advance();
+      prefix = data[i];
+    }
+    put(prefix);
+    advance();
+    put(end_code);
+  }
+  if (pending_count > 0) {
+    output.push_back(static_cast<unsigned char>(pending_bits << (8 - pending_count)));
+  }
+}
+
+bool TiffCompression::zstd(const unsigned char *data, std::size_t size,
+                           std::vector<unsigned char> &output) {
+#ifdef WATERCOHERER_USE_ZSTD
+  output.resize(ZSTD_compressBound(size));
+  std::size_t compressed_size = ZSTD_compress(output.data(), output.size(), data, size, 9);
+  if (ZSTD_isError(compressed_size)) {
+    return false;
+  }
+  output.resize(compressed_size);
+  return true;
+#else
+  (void) data;
+  (void) size;
+  (void) output;
+  return false;
+#endif
+}
+
+bool TiffCompression::zstd_available() {
+#ifdef WATERCOHERER_USE_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
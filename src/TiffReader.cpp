@@ -0,0 +1,480 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "TiffReader.hpp"
+#include "RasterKernels.hpp"
+#include "RasterPartitioner.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  // A band is stored in blocks: strips spanning its whole width or tiles.
+  struct BandLayout {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool tiled = false;
+    uint32_t block_width = 0;
+    uint32_t block_height = 0;
+    uint32_t blocks = 0;
+  };
+
+  // Only single sample 8-bit bands are decoded here.
+  bool read_layout(TIFF *tiff, BandLayout &layout) {
+    uint16_t bits_per_sample = 0;
+    uint16_t samples_per_pixel = 0;
+    uint16_t sample_format = 0;
+    bool supported = TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &layout.width) &&
+                     TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &layout.height) &&
+                     TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample) &&
+                     TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel) &&
+                     TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sample_format) &&
+                     bits_per_sample == 8 && samples_per_pixel == 1 &&
+                     sample_format == SAMPLEFORMAT_UINT;
+    layout.tiled = TIFFIsTiled(tiff);
+    if (layout.tiled) {
+      supported = supported && TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &layout.block_width) &&
+                  TIFFGetField(tiff, TIFFTAG_TILELENGTH, &layout.block_height);
+      layout.blocks = TIFFNumberOfTiles(tiff);
+    } else {
+      layout.block_width = layout.width;
+      supported = supported &&
+                  TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &layout.block_height);
+      layout.blocks = TIFFNumberOfStrips(tiff);
+      // Files without the tag store the whole band in one strip.
+      layout.block_height = std::min(layout.block_height, layout.height);
+    }
+    return supported && layout.width > 0 && layout.height > 0 && layout.block_width > 0 &&
+           layout.block_height > 0;
+  }
+
+  // Band in a file, or in memory when buffer is set; every open() returns a handle of its own.
+  struct TiffSource {
+    const std::string &name;
+    const TiffBuffer *buffer;
+
+    TIFF *open() const {
+      if (nullptr != buffer) {
+        return buffer->open();
+      }
+      GeoReference::register_tags();
+      return TIFFOpen(name.c_str(), "r");
+    }
+  };
+
+  bool read_layout(const TiffSource &source, BandLayout &layout) {
+    TIFF *tiff = source.open();
+    if (nullptr == tiff) {
+      return false;
+    }
+    bool supported = read_layout(tiff, layout);
+    TIFFClose(tiff);
+    return supported;
+  }
+
+  // CImg reads only files, so other layouts in memory cannot be decoded.
+  TiffImage load_other_layout(const TiffSource &source) {
+    TiffImage image_layer{};
+    if (nullptr != source.buffer) {
+      std::cerr << "WARNING WaterCoherer: Input image layer cannot be decoded:\n" << "\t" +
+                source.name << std::endl;
+      return image_layer;
+    }
+    image_layer.load_tiff(source.name.c_str());
+    return image_layer;
+  }
+
+  bool read_size(const TiffSource &source, unsigned int &width, unsigned int &height) {
+    TIFF *tiff = source.open();
+    if (nullptr == tiff) {
+      return false;
+    }
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    bool known = TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &image_width) &&
+                 TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &image_height);
+    TIFFClose(tiff);
+    width = image_width;
+    height = image_height;
+    return known;
+  }
+
+  TiffImage load_window(const TiffSource &source, const PixelWindow &window, unsigned int cores,
+                        ThreadPool &pool) {
+    BandLayout layout;
+    bool decodable = read_layout(source, layout);
+    TiffImage image_layer{};
+    if (!decodable) {
+      // CImg decodes the whole band and the window is cut out of it afterwards.
+      image_layer = load_other_layout(source);
+      layout.width = image_layer.width();
+      layout.height = image_layer.height();
+    }
+    if (!window.fits_into(layout.width, layout.height)) {
+      std::cerr << "WARNING WaterCoherer: Window lies outside of input image layer:\n" << "\t" +
+                source.name << std::endl;
+      return TiffImage();
+    }
+    if (!decodable) {
+      return image_layer.get_crop(window.x, window.y, window.x + window.width - 1,
+                                  window.y + window.height - 1);
+    }
+
+    uint32_t blocks_across = (layout.width + layout.block_width - 1) / layout.block_width;
+    uint32_t first_column = window.x / layout.block_width;
+    uint32_t columns = (window.x + window.width - 1) / layout.block_width - first_column + 1;
+    uint32_t first_row = window.y / layout.block_height;
+    uint32_t rows = (window.y + window.height - 1) / layout.block_height - first_row + 1;
+
+    // The pixels are left untouched when allocated; see load() for how blocks are handed out.
+    image_layer.assign(window.width, window.height, 1, 1);
+    RasterPartitioner blocks(columns, rows, 1, 1);
+    std::atomic<bool> failed{false};
+    unsigned int workers = std::min(std::max(cores, 1u), blocks.tile_count());
+    pool.parallel_for(workers, [&source, &window, &layout, &image_layer, blocks_across,
+                                first_column, first_row, &blocks, &failed](unsigned int) {
+      TIFF *tiff = source.open();
+      if (nullptr == tiff) {
+        failed = true;
+        return;
+      }
+      std::vector<unsigned char> block(static_cast<size_t>(layout.block_width) *
+                                       layout.block_height);
+      auto size = static_cast<tmsize_t>(block.size());
+      RasterTile tile{};
+      while (!failed && blocks.next(tile)) {
+        uint32_t row = first_row + tile.y_begin;
+        for (uint32_t column = first_column + tile.x_begin;
+             column < first_column + tile.x_end && !failed; ++column) {
+          uint32_t number = row * blocks_across + column;
+          tmsize_t decoded = layout.tiled ? TIFFReadEncodedTile(tiff, number, block.data(), size)
+                                          : TIFFReadEncodedStrip(tiff, number, block.data(),
+                                                                 size);
+          if (decoded < 0) {
+            failed = true;
+            break;
+          }
+
+          // Part of the block inside the window, in band coordinates.
+          uint32_t block_x = column * layout.block_width;
+          uint32_t block_y = row * layout.block_height;
+          uint32_t x_begin = std::max(block_x, window.x);
+          uint32_t x_end = std::min(block_x + layout.block_width, window.x + window.width);
+          uint32_t y_begin = std::max(block_y, window.y);
+          uint32_t y_end = std::min(block_y + layout.block_height, window.y + window.height);
+          for (uint32_t y = y_begin; y < y_end; ++y) {
+            std::memcpy(image_layer.data(x_begin - window.x, y - window.y),
+                        block.data() + static_cast<size_t>(y - block_y) * layout.block_width +
+                            (x_begin - block_x),
+                        x_end - x_begin);
+          }
+        }
+      }
+      TIFFClose(tiff);
+    });
+
+    if (failed) {
+      std::cerr << "WARNING WaterCoherer: Could not decode input image layer:\n" << "\t" +
+                source.name << std::endl;
+      return TiffImage();
+    }
+    return image_layer;
+  }
+
+  TiffImage load(const TiffSource &source, unsigned int cores, ThreadPool &pool) {
+    BandLayout layout;
+    if (!read_layout(source, layout)) {
+      return load_other_layout(source);
+    }
+    // Tiles, as in our COG outputs, are copied out of their blocks like any window.
+    if (layout.tiled) {
+      return load_window(source, PixelWindow{0, 0, layout.width, layout.height}, cores, pool);
+    }
+
+    // The pixels are left untouched when allocated. Strips are handed out like the tiles of
+    // RasterPartitioner, each NUMA node's workers taking the strips of their own range of rows
+    // first, so decoding a strip first touches its pages on the node whose workers process
+    // those rows later; the band never has to be copied to its nodes.
+    TiffImage image_layer(layout.width, layout.height, 1, 1);
+    RasterPartitioner strips(1, layout.blocks, 1, 1);
+    std::atomic<bool> failed{false};
+    unsigned int workers = std::min(std::max(cores, 1u), layout.blocks);
+    pool.parallel_for(workers, [&source, &layout, &image_layer, &strips,
+                                &failed](unsigned int) {
+      // libtiff handles keep the current strip and codec state, so they are never shared.
+      TIFF *tiff = source.open();
+      if (nullptr == tiff) {
+        failed = true;
+        return;
+      }
+      RasterTile tile{};
+      while (!failed && strips.next(tile)) {
+        uint32_t strip = tile.y_begin;
+        uint32_t row = strip * layout.block_height;
+        if (row >= layout.height) {
+          continue;
+        }
+        uint32_t rows = std::min(layout.block_height, layout.height - row);
+        auto size = static_cast<tmsize_t>(rows) * layout.width;
+        if (TIFFReadEncodedStrip(tiff, strip, image_layer.data(0, row), size) != size) {
+          failed = true;
+        }
+      }
+      TIFFClose(tiff);
+    });
+
+    if (failed) {
+      std::cerr << "WARNING WaterCoherer: Could not decode input image layer:\n" << "\t" +
+                source.name << std::endl;
+      return TiffImage();
+    }
+    return image_layer;
+  }
+}
+
+TiffImage TiffReader::load(const std::string &path, unsigned int cores, ThreadPool &pool) {
+  return ::load(TiffSource{path, nullptr}, cores, pool);
+}
+
+TiffImage TiffReader::load(const TiffBuffer &buffer, unsigned int cores, ThreadPool &pool) {
+  return ::load(TiffSource{buffer.name(), &buffer}, cores, pool);
+}
+
+bool TiffReader::read_size(const std::string &path, unsigned int &width, unsigned int &height) {
+  return ::read_size(TiffSource{path, nullptr}, width, height);
+}
+
+bool TiffReader::read_size(const TiffBuffer &buffer, unsigned int &width, unsigned int &height) {
+  return ::read_size(TiffSource{buffer.name(), &buffer}, width, height);
+}
+
+TiffImage TiffReader::load_window(const std::string &path, const PixelWindow &window,
+                                  unsigned int cores, ThreadPool &pool) {
+  return ::load_window(TiffSource{path, nullptr}, window, cores, pool);
+}
+
+TiffImage TiffReader::load_window(const TiffBuffer &buffer, const PixelWindow &window,
+                                  unsigned int cores, ThreadPool &pool) {
+  return ::load_window(TiffSource{buffer.name(), &buffer}, window, cores, pool);
+}
+
+PixelMask TiffReader::load_mask(const std::string &path, unsigned int cores) {
+  GeoReference::register_tags();
+  TIFF *tiff = TIFFOpen(path.c_str(), "r");
+  if (nullptr == tiff) {
+    std::cerr << "WARNING WaterCoherer: Could not open input mask:\n" << "\t" + path
+              << std::endl;
+    return PixelMask();
+  }
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint16_t bits_per_sample = 0;
+  uint16_t samples_per_pixel = 0;
+  uint16_t photometric = PHOTOMETRIC_MINISBLACK;
+  uint32_t block_width = 0;
+  uint32_t block_height = 0;
+  bool tiled = TIFFIsTiled(tiff);
+  bool readable = TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width) &&
+                  TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height) &&
+                  TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample) &&
+                  TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel) &&
+                  samples_per_pixel == 1 && width > 0 && height > 0;
+  TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+  if (tiled) {
+    readable = readable && TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &block_width) &&
+               TIFFGetField(tiff, TIFFTAG_TILELENGTH, &block_height);
+  } else {
+    block_width = width;
+    readable = readable && TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &block_height);
+    block_height = std::min(block_height, height);
+  }
+  TIFFClose(tiff);
+
+  // Masks written one byte per pixel, 0 or 255, are packed after decoding.
+  if (readable && bits_per_sample == 8) {
+    auto layer = load(path, cores);
+    PixelMask result(layer.width(), layer.height());
+    for (unsigned int y = 0; y < result.height(); ++y) {
+      RasterKernels::threshold_above(layer.data(0, y), result.width(), 0, result.row(y));
+    }
+    return result;
+  }
+  if (!readable || bits_per_sample != 1 || 0 == block_width || 0 == block_height) {
+    std::cerr << "WARNING WaterCoherer: Input file is no mask:\n" << "\t" + path << std::endl;
+    return PixelMask();
+  }
+
+  // Every worker takes whole strips or rows of tiles, so no two of them share mask words.
+  PixelMask result(width, height);
+  unsigned int block_rows = (height + block_height - 1) / block_height;
+  unsigned int blocks_across = (width + block_width - 1) / block_width;
+  std::size_t row_bytes = (block_width + 7) / 8;
+  bool inverted = photometric == PHOTOMETRIC_MINISWHITE;
+  std::atomic<unsigned int> next_block_row{0};
+  std::atomic<bool> failed{false};
+  unsigned int workers = std::min(std::max(cores, 1u), block_rows);
+  ThreadPool::instance().parallel_for(workers, [&path, &result, &next_block_row, &failed, width,
+                                                height, tiled, block_width, block_height,
+                                                block_rows, blocks_across, row_bytes,
+                                                inverted](unsigned int) {
+    TIFF *tiff = TIFFOpen(path.c_str(), "r");
+    if (nullptr == tiff) {
+      failed = true;
+      return;
+    }
+    std::vector<unsigned char> block(row_bytes * block_height);
+    auto size = static_cast<tmsize_t>(block.size());
+    unsigned int block_row;
+    while (!failed && (block_row = next_block_row++) < block_rows) {
+      unsigned int y_begin = block_row * block_height;
+      unsigned int y_end = std::min(y_begin + block_height, height);
+      for (unsigned int column = 0; column < blocks_across && !failed; ++column) {
+        uint32_t number = block_row * blocks_across + column;
+        tmsize_t decoded = tiled ? TIFFReadEncodedTile(tiff, number, block.data(), size)
+                                 : TIFFReadEncodedStrip(tiff, number, block.data(), size);
+        if (decoded < 0) {
+          failed = true;
+          break;
+        }
+        if (inverted) {
+          for (auto &byte : block) {
+            byte = static_cast<unsigned char>(~byte);
+          }
+        }
+        unsigned int x_begin = column * block_width;
+        for (unsigned int y = y_begin; y < y_end; ++y) {
+          result.unpack_msb_first(y, x_begin, std::min(block_width, width - x_begin),
+                                  block.data() + (y - y_begin) * row_bytes);
+        }
+      }
+    }
+    TIFFClose(tiff);
+  });
+
+  if (failed) {
+    std::cerr << "WARNING WaterCoherer: Could not decode input mask:\n" << "\t" + path
+              << std::endl;
+    return PixelMask();
+  }
+  return result;
+}
+
+TiffStripReader::TiffStripReader(const std::string &path) : path_(path) {
+  GeoReference::register_tags();
+  tiff_ = TIFFOpen(path.c_str(), "r");
+  if (nullptr == tiff_) {
+    return;
+  }
+  BandLayout layout;
+  if (!read_layout(tiff_, layout)) {
+    std::cerr << "WARNING WaterCoherer: Input image layer cannot be streamed:\n" << "\t" + path
+              << std::endl;
+    TIFFClose(tiff_);
+    tiff_ = nullptr;
+    return;
+  }
+  width_ = layout.width;
+  height_ = layout.height;
+  tiled_ = layout.tiled;
+  block_width_ = layout.block_width;
+  block_height_ = layout.block_height;
+}
+
+TiffStripReader::~TiffStripReader() {
+  if (nullptr != tiff_) {
+    TIFFClose(tiff_);
+  }
+}
+
+bool TiffStripReader::is_open() const {
+  return nullptr != tiff_;
+}
+
+unsigned int TiffStripReader::width() const {
+  return width_;
+}
+
+unsigned int TiffStripReader::height() const {
+  return height_;
+}
+
+unsigned int TiffStripReader::rows_per_strip() const {
+  return block_height_;
+}
+
+bool TiffStripReader::decode_block_row(unsigned int block_row) {
+  block_rows_.resize(static_cast<std::size_t>(width_) * block_height_);
+  if (!tiled_) {
+    auto size = static_cast<tmsize_t>(block_rows_.size());
+    return TIFFReadEncodedStrip(tiff_, block_row, block_rows_.data(), size) >= 0;
+  }
+
+  // Tiles of the row are decoded one after another and copied next to each other.
+  std::vector<unsigned char> tile(static_cast<std::size_t>(block_width_) * block_height_);
+  unsigned int tiles_across = (width_ + block_width_ - 1) / block_width_;
+  for (unsigned int column = 0; column < tiles_across; ++column) {
+    uint32_t number = block_row * tiles_across + column;
+    if (TIFFReadEncodedTile(tiff_, number, tile.data(), static_cast<tmsize_t>(tile.size())) < 0) {
+      return false;
+    }
+    unsigned int x = column * block_width_;
+    unsigned int width = std::min(block_width_, width_ - x);
+    for (unsigned int y = 0; y < block_height_; ++y) {
+      std::memcpy(block_rows_.data() + static_cast<std::size_t>(y) * width_ + x,
+                  tile.data() + static_cast<std::size_t>(y) * block_width_, width);
+    }
+  }
+  return true;
+}
+
+bool TiffStripReader::read_rows(unsigned int row, unsigned int rows, TiffImage &destination) {
+  if (nullptr == tiff_ || row > height_ || rows > height_ - row) {
+    std::cerr << "WARNING WaterCoherer: Rows lie outside of input image layer:\n" << "\t" + path_
+              << std::endl;
+    return false;
+  }
+  destination.assign(width_, rows, 1, 1);
+  for (unsigned int y = row; y < row + rows; ++y) {
+    auto block_row = static_cast<long>(y / block_height_);
+    if (block_row != decoded_block_row_) {
+      decoded_block_row_ = -1;
+      if (!decode_block_row(block_row)) {
+        std::cerr << "WARNING WaterCoherer: Could not decode input image layer:\n" <<
+                  "\t" + path_ << std::endl;
+        return false;
+      }
+      decoded_block_row_ = block_row;
+    }
+    std::memcpy(destination.data(0, y - row),
+                block_rows_.data() + static_cast<std::size_t>(y % block_height_) * width_,
+                width_);
+  }
+  return true;
+}
@@ -0,0 +1,220 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include "TiffWriter.hpp"
+#include "ThreadPool.hpp"
+#include "TiffCompression.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  // The layer's outer corner is tied to its map position; the GeoKeys are copied unchanged.
+  void write_georeference(TIFF *tiff, const GeoReference &georeference) {
+    double pixel_scale[3] = {georeference.pixel_width(), georeference.pixel_height(), 0.};
+    double tiepoint[6] = {0., 0., 0., georeference.origin_x(), georeference.origin_y(), 0.};
+    TIFFSetField(tiff, GeoReference::model_pixel_scale_tag, 3, pixel_scale);
+    TIFFSetField(tiff, GeoReference::model_tiepoint_tag, 6, tiepoint);
+    if (!georeference.geo_keys().empty()) {
+      TIFFSetField(tiff, GeoReference::geo_key_directory_tag,
+                   static_cast<int>(georeference.geo_keys().size()),
+                   georeference.geo_keys().data());
+    }
+    if (!georeference.geo_doubles().empty()) {
+      TIFFSetField(tiff, GeoReference::geo_double_params_tag,
+                   static_cast<int>(georeference.geo_doubles().size()),
+                   georeference.geo_doubles().data());
+    }
+    if (!georeference.geo_ascii().empty()) {
+      TIFFSetField(tiff, GeoReference::geo_ascii_params_tag, georeference.geo_ascii().c_str());
+    }
+  }
+
+  TIFF *open_output(const std::string &path, uint32_t width, uint32_t height,
+                    uint32_t rows_per_strip, TiffStripWriter::Compression compression,
+                    const GeoReference &georeference) {
+    GeoReference::register_tags();
+    TIFF *tiff = TIFFOpen(path.c_str(), "w");
+    if (nullptr == tiff) {
+      std::cerr << "WARNING WaterCoherer: Could not open output file:\n" << "\t" + path
+                << std::endl;
+      return nullptr;
+    }
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, width);
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, height);
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 1);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+    TIFFSetField(tiff, TIFFTAG_COMPRESSION,
+                 compression == TiffStripWriter::Compression::Deflate ? COMPRESSION_ADOBE_DEFLATE
+                                                                 : COMPRESSION_NONE);
+    if (georeference.valid()) {
+      write_georeference(tiff, georeference);
+    }
+    return tiff;
+  }
+}
+
+TiffStripWriter::TiffStripWriter(const std::string &path, unsigned int width, unsigned int height,
+                                 const GeoReference &georeference,
+                                 TiffStripWriter::Compression compression)
+  : path_(path), width_(width), height_(height), compression_(compression) {
+  row_bytes_ = (width + 7) / 8;
+  rows_per_strip_ = std::max(1u, strip_bytes / std::max(row_bytes_, 1u));
+  if (0 == width || 0 == height) {
+    std::cerr << "WARNING WaterCoherer: Mask cannot be written as TIFF:\n" << "\t" + path
+              << std::endl;
+    return;
+  }
+  tiff_ = open_output(path, width, height, rows_per_strip_, compression, georeference);
+  pending_.resize(static_cast<std::size_t>(std::min(rows_per_strip_, height)) * row_bytes_);
+}
+
+TiffStripWriter::~TiffStripWriter() {
+  if (nullptr != tiff_) {
+    close();
+  }
+}
+
+bool TiffStripWriter::is_open() const {
+  return nullptr != tiff_;
+}
+
+unsigned int TiffStripWriter::rows_per_strip() const {
+  return rows_per_strip_;
+}
+
+bool TiffStripWriter::write_strips(const unsigned char *rows, unsigned int strip_count,
+                                   unsigned int strip_rows, unsigned int cores) {
+  // The strips of one call are compressed together, then written in file order.
+  std::vector<std::vector<unsigned char>> strips(strip_count);
+  std::atomic<unsigned int> next_strip{0};
+  std::atomic<bool> failed{false};
+  std::size_t strip_size = static_cast<std::size_t>(strip_rows) * row_bytes_;
+  unsigned int workers = std::min(std::max(cores, 1u), strip_count);
+  ThreadPool::instance().parallel_for(workers, [this, rows, strip_size, &strips, &next_strip,
+                                                &failed](unsigned int) {
+    unsigned int strip;
+    while (!failed && (strip = next_strip++) < strips.size()) {
+      const unsigned char *begin = rows + strip * strip_size;
+      if (compression_ == TiffStripWriter::Compression::Uncompressed) {
+        strips[strip].assign(begin, begin + strip_size);
+      } else if (!TiffCompression::deflate(begin, strip_size, strips[strip])) {
+        failed = true;
+      }
+    }
+  });
+
+  for (std::size_t i = 0; i < strips.size() && !failed; ++i) {
+    auto size = static_cast<tmsize_t>(strips[i].size());
+    if (TIFFWriteRawStrip(tiff_, next_strip_++, strips[i].data(), size) != size) {
+      failed = true;
+    }
+  }
+  return !failed;
+}
+
+bool TiffStripWriter::write_packed_rows(const unsigned char *rows, unsigned int count,
+                                        unsigned int cores) {
+  unsigned int row = 0;
+  // A strip begun by an earlier call is completed first.
+  while (pending_rows_ > 0 && row < count && !failed_) {
+    std::memcpy(pending_.data() + static_cast<std::size_t>(pending_rows_) * row_bytes_,
+                rows + static_cast<std::size_t>(row) * row_bytes_, row_bytes_);
+    ++pending_rows_;
+    ++row;
+    if (pending_rows_ == rows_per_strip_) {
+      failed_ = !write_strips(pending_.data(), 1, rows_per_strip_, cores);
+      pending_rows_ = 0;
+    }
+  }
+
+  unsigned int full_strips = (count - row) / rows_per_strip_;
+  if (!failed_ && full_strips > 0) {
+    failed_ = !write_strips(rows + static_cast<std::size_t>(row) * row_bytes_, full_strips,
+                            rows_per_strip_, cores);
+    row += full_strips * rows_per_strip_;
+  }
+  if (row < count) {
+    std::memcpy(pending_.data() + static_cast<std::size_t>(pending_rows_) * row_bytes_,
+                rows + static_cast<std::size_t>(row) * row_bytes_,
+                static_cast<std::size_t>(count - row) * row_bytes_);
+    pending_rows_ += count - row;
+  }
+
+  rows_received_ += count;
+  if (!failed_ && rows_received_ == height_ && pending_rows_ > 0) {
+    failed_ = !write_strips(pending_.data(), 1, pending_rows_, cores);
+    pending_rows_ = 0;
+  }
+  if (failed_) {
+    std::cerr << "WARNING WaterCoherer: Could not write output file:\n" << "\t" + path_
+              << std::endl;
+  }
+  return !failed_;
+}
+
+bool TiffStripWriter::write_rows(const PixelMask &rows, unsigned int cores) {
+  if (nullptr == tiff_ || failed_) {
+    return false;
+  }
+  if (rows.width() != width_ || rows_received_ + rows.height() > height_) {
+    std::cerr << "WARNING WaterCoherer: Rows do not fit into output file:\n" << "\t" + path_
+              << std::endl;
+    failed_ = true;
+    return false;
+  }
+
+  std::vector<unsigned char> packed(static_cast<std::size_t>(rows.height()) * row_bytes_);
+  for (unsigned int y = 0; y < rows.height(); ++y) {
+    rows.pack_msb_first(y, 0, width_, packed.data() + static_cast<std::size_t>(y) * row_bytes_);
+  }
+  return write_packed_rows(packed.data(), rows.height(), cores);
+}
+
+bool TiffStripWriter::close() {
+  if (nullptr == tiff_) {
+    return false;
+  }
+  TIFFClose(tiff_);
+  tiff_ = nullptr;
+  if (failed_ || rows_received_ != height_) {
+    std::remove(path_.c_str());
+    if (!failed_) {
+      std::cerr << "WARNING WaterCoherer: Output file closed before all rows were written:\n"
+                << "\t" + path_ << std::endl;
+    }
+    return false;
+  }
+  return true;
+}
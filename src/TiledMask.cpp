@@ -0,0 +1,189 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "TiledMask.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace WaterCoherer;
+
+TiledMask::TiledMask(unsigned int width, unsigned int height) :
+  width_(width), height_(height), tiles_x_((width + tile_size - 1) / tile_size),
+  tiles_y_((height + tile_size - 1) / tile_size),
+  states_(static_cast<std::size_t>(tiles_x_) * tiles_y_, TileState::Empty),
+  words_(states_.size() * tile_size) {
+}
+
+TiledMask TiledMask::from_pixel_mask(const PixelMask &pixel_mask) {
+  TiledMask result(pixel_mask.width(), pixel_mask.height());
+  Word words[tile_size];
+  for (unsigned int tile_y = 0; tile_y < result.tiles_y_; ++tile_y) {
+    for (unsigned int tile_x = 0; tile_x < result.tiles_x_; ++tile_x) {
+      for (unsigned int y = 0; y < result.tile_height(tile_y); ++y) {
+        words[y] = pixel_mask.row(tile_y * tile_size + y)[tile_x];
+      }
+      result.store_tile(tile_x, tile_y, words);
+    }
+  }
+  return result;
+}
+
+PixelMask TiledMask::to_pixel_mask() const {
+  PixelMask result(width_, height_);
+  for (unsigned int tile_y = 0; tile_y < tiles_y_; ++tile_y) {
+    for (unsigned int tile_x = 0; tile_x < tiles_x_; ++tile_x) {
+      std::size_t index = tile_index(tile_x, tile_y);
+      if (states_[index] == TileState::Empty) {
+        continue;
+      }
+      for (unsigned int y = 0; y < tile_height(tile_y); ++y) {
+        result.row(tile_y * tile_size + y)[tile_x] =
+          states_[index] == TileState::Full ? valid_bits(tile_x) : rows(index)[y];
+      }
+    }
+  }
+  return result;
+}
+
+unsigned int TiledMask::width() const {
+  return width_;
+}
+
+unsigned int TiledMask::height() const {
+  return height_;
+}
+
+unsigned int TiledMask::tiles_x() const {
+  return tiles_x_;
+}
+
+unsigned int TiledMask::tiles_y() const {
+  return tiles_y_;
+}
+
+bool TiledMask::same_size(const TiledMask &other) const {
+  return width_ == other.width_ && height_ == other.height_;
+}
+
+TiledMask::Word TiledMask::valid_bits(unsigned int tile_x) const {
+  unsigned int width = tile_width(tile_x);
+  return width == tile_size ? ~Word{0} : (Word{1} << width) - 1;
+}
+
+unsigned int TiledMask::tile_width(unsigned int tile_x) const {
+  return std::min(tile_size, width_ - tile_x * tile_size);
+}
+
+unsigned int TiledMask::tile_height(unsigned int tile_y) const {
+  return std::min(tile_size, height_ - tile_y * tile_size);
+}
+
+const TiledMask::Word *TiledMask::tile_rows(unsigned int tile_x, unsigned int tile_y) const {
+  std::size_t index = tile_index(tile_x, tile_y);
+  return states_[index] == TileState::Mixed ? rows(index) : nullptr;
+}
+
+void TiledMask::store_tile(unsigned int tile_x, unsigned int tile_y, const Word *words) {
+  Word valid = valid_bits(tile_x);
+  Word any = 0;
+  Word all = valid;
+  for (unsigned int y = 0; y < tile_height(tile_y); ++y) {
+    any |= words[y] & valid;
+    all &= words[y];
+  }
+
+  std::size_t index = tile_index(tile_x, tile_y);
+  if (!any) {
+    states_[index] = TileState::Empty;
+  } else if (all == valid) {
+    states_[index] = TileState::Full;
+  } else {
+    states_[index] = TileState::Mixed;
+    for (unsigned int y = 0; y < tile_height(tile_y); ++y) {
+      rows(index)[y] = words[y] & valid;
+    }
+  }
+}
+
+void TiledMask::fill_tile(unsigned int tile_x, unsigned int tile_y, TileState state) {
+  states_[tile_index(tile_x, tile_y)] = state;
+}
+
+bool TiledMask::test(unsigned int x, unsigned int y) const {
+  std::size_t index = tile_index(x / tile_size, y / tile_size);
+  switch (states_[index]) {
+    case TileState::Empty:
+      return false;
+    case TileState::Full:
+      return true;
+    default:
+      return (rows(index)[y % tile_size] >> (x % tile_size)) & 1U;
+  }
+}
+
+std::size_t TiledMask::count() const {
+  std::size_t result = 0;
+  for (unsigned int tile_y = 0; tile_y < tiles_y_; ++tile_y) {
+    for (unsigned int tile_x = 0; tile_x < tiles_x_; ++tile_x) {
+      std::size_t index = tile_index(tile_x, tile_y);
+      if (states_[index] == TileState::Full) {
+        result += static_cast<std::size_t>(tile_width(tile_x)) * tile_height(tile_y);
+      } else if (states_[index] == TileState::Mixed) {
+        for (unsigned int y = 0; y < tile_height(tile_y); ++y) {
+          result += static_cast<std::size_t>(__builtin_popcountll(rows(index)[y]));
+        }
+      }
+    }
+  }
+  return result;
+}
+
+TiledMask &TiledMask::operator|=(const TiledMask &other) {
+  if (states_.empty()) {
+    return *this = other;
+  }
+  if (!same_size(other)) {
+    std::cerr << "WARNING WaterCoherer: Omitted tiled mask of different size." << std::endl;
+    return *this;
+  }
+  for (unsigned int tile_y = 0; tile_y < tiles_y_; ++tile_y) {
+    for (unsigned int tile_x = 0; tile_x < tiles_x_; ++tile_x) {
+      std::size_t index = tile_index(tile_x, tile_y);
+      TileState added = other.states_[index];
+      if (added == TileState::Empty || states_[index] == TileState::Full) {
+        continue;
+      }
+      if (added == TileState::Full || states_[index] == TileState::Empty) {
+        states_[index] = added;
+        std::copy(other.rows(index), other.rows(index) + tile_size, rows(index));
+        continue;
+      }
+      Word united[tile_size];
+      for (unsigned int y = 0; y < tile_height(tile_y); ++y) {
+        united[y] = rows(index)[y] | other.rows(index)[y];
+      }
+      store_tile(tile_x, tile_y, united);
+    }
+  }
+  return *this;
+}
@@ -0,0 +1,48 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+#include "TwoBandLookupTable.hpp"
+#include "RasterKernels.hpp"
+
+using namespace WaterCoherer;
+
+TwoBandLookupTable TwoBandLookupTable::normalized_difference(float threshold, bool inclusive) {
+  return build([threshold, inclusive](unsigned char first, unsigned char second) {
+    float first_value = first;
+    float second_value = second;
+    if (first_value > 1.f && second_value > 1.f) {
+      float index = (first_value - second_value) / (first_value + second_value);
+      return inclusive ? index >= threshold : index > threshold;
+    }
+    return false;
+  });
+}
+
+const unsigned char *TwoBandLookupTable::data() const {
+  return table_.data();
+}
+
+void TwoBandLookupTable::classify_row(const unsigned char *first, const unsigned char *second,
+                                      unsigned int width, PixelMask::Word *words) const {
+  RasterKernels::lookup_two_band(table_.data(), first, second, width, words);
+}
@@ -21,17 +21,49 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "Utils.hpp"
+#include "RasterKernels.hpp"
+#include "RasterPartitioner.hpp"
 #include <algorithm>
+#include <iostream>
 #include <string>
-#include <set>
 
 namespace WaterCoherer {
-  PixelPositions merge_pixel_positions_layers(PixelPositionsLayers &found_water) {
-    PixelPositions result;
+  PixelMask merge_pixel_positions_layers(const PixelPositionsLayers &found_water,
+                                         unsigned int cores) {
+    std::vector<const PixelMask *> layers;
     for (const auto &entry : found_water) {
-      PixelPositions pixel_set = entry.second;
-      std::merge(pixel_set.begin(), pixel_set.end(), result.begin(), result.end(),
-                 std::inserter(result, result.begin()));
+      if (!layers.empty() && !layers.front()->same_size(entry.second)) {
+        std::cerr << "WARNING WaterCoherer: Omitted pixel mask of different size:\n" << "\t" +
+        entry.first << std::endl;
+        continue;
+      }
+      layers.push_back(&entry.second);
+    }
+    if (layers.empty()) {
+      return PixelMask();
+    }
+
+    PixelMask result(layers.front()->width(), layers.front()->height());
+    RasterPartitioner partitioner(result.width(), result.height());
+    partitioner.run(cores, [&result, &layers](const RasterTile &tile) {
+      std::size_t word_begin = tile.x_begin / PixelMask::word_bits;
+      std::size_t word_count = PixelMask::words_for_width(tile.width());
+
+      // One row of the tile stays in cache while every layer is OR-ed into it.
+      for (unsigned int y = tile.y_begin; y < tile.y_end; ++y) {
+        for (const auto *layer : layers) {
+          RasterKernels::unite(result.row(y) + word_begin, layer->row(y) + word_begin,
+                               word_count);
+        }
+      }
+    });
+    return result;
+  }
+
+  RunLengthMask merge_pixel_positions_layers(const RunLengthMaskLayers &found_water) {
+    RunLengthMask result;
+    for (const auto &entry : found_water) {
+      result = RunLengthMask::unite(result, entry.second);
     }
     return result;
   }
@@ -49,11 +81,45 @@ namespace WaterCoherer {
     return result;
   }
 
-  TiffImage generate_layer(const PixelPositions &pixel_positions, int width,
-    int height) {
-    TiffImage result(width, height, 1, 1);
-    for (const auto &pixel: pixel_positions) {
-      result(pixel.first, pixel.second) = 255;
+  TiffImage generate_layer(const PixelMask &pixel_mask) {
+    TiffImage result(pixel_mask.width(), pixel_mask.height(), 1, 1);
+    for (unsigned int y = 0; y < pixel_mask.height(); ++y) {
+      RasterKernels::expand(pixel_mask.row(y), pixel_mask.width(), result.data(0, y));
+    }
+    return result;
+  }
+
+  TiffImage generate_layer(const RunLengthMask &run_length_mask) {
+    TiffImage result(run_length_mask.width(), run_length_mask.height(), 1, 1, 0);
+    for (unsigned int y = 0; y < run_length_mask.height(); ++y) {
+      unsigned char *pixels = result.data(0, y);
+      for (auto run = run_length_mask.row_begin(y); run != run_length_mask.row_end(y); ++run) {
+        std::fill(pixels + run->begin, pixels + run->end, 255);
+      }
+    }
+    return result;
+  }
+
+  TiffImage generate_layer(const TiledMask &tiled_mask) {
+    TiffImage result(tiled_mask.width(), tiled_mask.height(), 1, 1);
+    for (unsigned int tile_y = 0; tile_y < tiled_mask.tiles_y(); ++tile_y) {
+      for (unsigned int tile_x = 0; tile_x < tiled_mask.tiles_x(); ++tile_x) {
+        unsigned int x_begin = tile_x * TiledMask::tile_size;
+        unsigned int y_begin = tile_y * TiledMask::tile_size;
+        unsigned int tile_width = tiled_mask.tile_width(tile_x);
+        const TiledMask::Word *rows = tiled_mask.tile_rows(tile_x, tile_y);
+        for (unsigned int y = 0; y < tiled_mask.tile_height(tile_y); ++y) {
+          unsigned char *pixels = result.data(x_begin, y_begin + y);
+          if (!rows) {
+            bool full = tiled_mask.tile_state(tile_x, tile_y) == TiledMask::TileState::Full;
+            std::fill(pixels, pixels + tile_width, full ? 255 : 0);
+            continue;
+          }
+          for (unsigned int x = 0; x < tile_width; ++x) {
+            pixels[x] = ((rows[y] >> x) & 1U) ? 255 : 0;
+          }
+        }
+      }
     }
     return result;
   }
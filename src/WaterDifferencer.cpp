@@ -21,24 +21,51 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "WaterDifferencer.hpp"
+#include "RasterKernels.hpp"
 
 #include <utility>
 
 using namespace WaterCoherer;
 
-WaterDifferencer::WaterDifferencer(PixelPositions water_localization) :
+WaterDifferencer::WaterDifferencer(PixelMask water_localization) :
   water_localization_(std::move(water_localization)) {
 }
 
 TiffImage WaterDifferencer::generate_clasterized_water_layer(const TiffImage &image_layer) {
-  TiffImage result(image_layer.width(), image_layer.height(), 1, 3);
+  TiffImage result(image_layer.width(), image_layer.height(), 1, 3, 0);
+  if (water_localization_.width() != static_cast<unsigned int>(image_layer.width()) ||
+      water_localization_.height() != static_cast<unsigned int>(image_layer.height())) {
+    std::cerr << "Water Differencer: Water localization does not match the layer!" << std::endl;
+    return result;
+  }
+
+  // Water with a near infrared value of at least 17 goes to the second channel, the rest of the
+  // water to the third one.
+  for (unsigned int y = 0; y < water_localization_.height(); ++y) {
+    RasterKernels::split_water_types(water_localization_.row(y), image_layer.data(0, y),
+                                     water_localization_.width(), 16, result.data(0, y, 0, 1),
+                                     result.data(0, y, 0, 2));
+  }
+  return result;
+}
+
+TiffImage WaterDifferencer::generate_clasterized_water_layer(const PixelMask &bright_water) {
+  TiffImage result(bright_water.width(), bright_water.height(), 1, 3, 0);
+  if (!water_localization_.same_size(bright_water)) {
+    std::cerr << "Water Differencer: Water localization does not match the layer!" << std::endl;
+    return result;
+  }
 
-  for (const auto &water_pixel: water_localization_) {
-    if (image_layer(water_pixel.first, water_pixel.second) >= 17.f) {
-      result(water_pixel.first, water_pixel.second, 1) = 255;
-    } else {
-      result(water_pixel.first, water_pixel.second, 2) = 255;
+  std::vector<PixelMask::Word> bright(water_localization_.words_per_row());
+  std::vector<PixelMask::Word> dark(water_localization_.words_per_row());
+  for (unsigned int y = 0; y < water_localization_.height(); ++y) {
+    const PixelMask::Word *water = water_localization_.row(y);
+    for (std::size_t w = 0; w < bright.size(); ++w) {
+      bright[w] = water[w] & bright_water.row(y)[w];
+      dark[w] = water[w] & ~bright_water.row(y)[w];
     }
+    RasterKernels::expand(bright.data(), water_localization_.width(), result.data(0, y, 0, 1));
+    RasterKernels::expand(dark.data(), water_localization_.width(), result.data(0, y, 0, 2));
   }
   return result;
 }
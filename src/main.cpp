@@ -21,89 +21,155 @@
 //  DEALINGS IN THE SOFTWARE.
 
 #include "NDWICalculator.hpp"
+#include "ResourceGovernor.hpp"
 #include "CloudDetection.hpp"
-
+#include "CogWriter.hpp"
+#include "SceneClassifier.hpp"
+#include "ScenePipeline.hpp"
+#include "StreamingClassifier.hpp"
+#include "TaskGraph.hpp"
+
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <thread>
+#include <string>
 #include <chrono>
+#include <utility>
+#include <vector>
 #include <LandsatImage.hpp>
 #include <Utils.hpp>
 
 using namespace WaterCoherer;
 
-int main() {
-  unsigned int cores = std::thread::hardware_concurrency();
+namespace {
+  struct Scene {
+    const char *name;
+    const char *directory;
+    LandsatImage image;
+    SceneClassification classification;
+    GeoReference georeference;
+    SceneSlot slot;
+  };
+}
+
+int main(int argc, char **argv) {
+  ResourceGovernor &governor = ResourceGovernor::instance();
+  unsigned int cores = governor.processors();
   std::cout << "INFO Water Coherer: Application starting..." << std::endl;
   std::cout << "INFO Water Coherer: Using " << cores << " logical processors." << std::endl;
-
-  LandsatImage oldest_image;
-  oldest_image.load_image("../data/LE71880252009232ASN00");
-
-  LandsatImage medium_image;
-  medium_image.load_image("../data/LE71880252009104ASN00");
-
-  LandsatImage recent_image;
-  recent_image.load_image("../data/LE71880252009264ASN00");
-
-  PixelPositionsLayers localized_clouds =
-    {
-      {"oldest", CloudDetection::localize_clouds(oldest_image.view_blue_layer(), cores)},
-      {"medium", CloudDetection::localize_clouds(medium_image.view_blue_layer(), cores)},
-      {"recent", CloudDetection::localize_clouds(recent_image.view_blue_layer(), cores)}
-    };
-
-  auto sumarized_cloud_positons = merge_pixel_positions_layers(localized_clouds);
-
-
-  auto water_localization_oldest = NDWICalculator::localize_water(cores,
-                                                                  oldest_image.view_green_layer(),
-                                                                  oldest_image.view_nir_layer(),
-                                                                  sumarized_cloud_positons);
-
-  std::cout << "INFO Water Coherer: Localized " << water_localization_oldest.size()
-            << " pixels of water."
-            << std::endl;
-
-  auto water_localization_medium = NDWICalculator::localize_water(cores,
-                                                                  medium_image.view_green_layer(),
-                                                                  medium_image.view_nir_layer(),
-                                                                  sumarized_cloud_positons);
-
-  std::cout << "INFO Water Coherer: Localized " << water_localization_medium.size()
-            << " pixels of water."
-            << std::endl;
-
-  auto water_localization_recent = NDWICalculator::localize_water(cores,
-                                                                  recent_image.view_green_layer(),
-                                                                  recent_image.view_nir_layer(),
-                                                                  sumarized_cloud_positons);
-
-  WaterDifferencer differencer(water_localization_recent);
-  differencer.generate_clasterized_water_layer(recent_image.view_nir_layer()).save_tiff
-    ("different_water_types.tif");
-
-  std::cout << "INFO Water Coherer: Localized " << water_localization_recent.size()
-            << " pixels of water."
-            << std::endl;
-
-  auto oldest_image_water = generate_layer(water_localization_oldest,
-                                           oldest_image.width(),
-                                           oldest_image.height());
-
-  auto medium_image_water = generate_layer(water_localization_medium,
-                                           medium_image.width(),
-                                           medium_image.height());
-
-  auto recent_image_water = generate_layer(water_localization_recent,
-                                           recent_image.width(),
-                                           recent_image.height());
-
-  auto common_clouds = generate_layer(sumarized_cloud_positons, oldest_image.width(),
-                                      oldest_image.height());
-
-  oldest_image_water.save_tiff("oldest_water.tif");
-  medium_image_water.save_tiff("medium_water.tif");
-  recent_image_water.save_tiff("recent_water.tif");
-  common_clouds.save_tiff("common_clouds.tif");
+  std::cout << "INFO Water Coherer: Keeping up to " << governor.max_scenes_in_memory()
+            << " scenes in memory." << std::endl;
+
+  // Batch mode: core [--stream | --window=x,y,width,height | --bbox=min_x,min_y,max_x,max_y]
+  //                  <output directory> <scene directory or .tar.gz archive>...
+  if (argc > 2) {
+    ScenePipeline pipeline(cores);
+    int first_argument = 1;
+    bool streaming = false;
+    PixelWindow window;
+    MapBoundingBox bounding_box;
+    if (std::string(argv[1]) == "--stream") {
+      streaming = true;
+      ++first_argument;
+    } else if (std::sscanf(argv[1], "--window=%u,%u,%u,%u", &window.x, &window.y, &window.width,
+                           &window.height) == 4) {
+      pipeline.restrict_to(window);
+      ++first_argument;
+    } else if (std::sscanf(argv[1], "--bbox=%lf,%lf,%lf,%lf", &bounding_box.min_x,
+                           &bounding_box.min_y, &bounding_box.max_x, &bounding_box.max_y) == 4) {
+      pipeline.restrict_to(bounding_box);
+      ++first_argument;
+    }
+    if (argc - first_argument < 2) {
+      std::cerr << "Usage: " << argv[0] << " [--stream | --window=x,y,width,height | "
+                << "--bbox=min_x,min_y,max_x,max_y] <output directory> "
+                << "<scene directory or archive>..." << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+    std::vector<std::string> scene_directories(argv + first_argument + 1, argv + argc);
+    if (streaming) {
+      // Scenes are streamed one after another, each of them with all processors.
+      for (const auto &scene_directory : scene_directories) {
+        StreamingClassifier::classify(scene_directory, argv[first_argument], cores);
+      }
+    } else {
+      pipeline.run(scene_directories, argv[first_argument]);
+    }
+    return 0;
+  }
+
+  Scene scenes[] = {
+    {"oldest", "../data/LE71880252009232ASN00", {}, {}, {}, {}},
+    {"medium", "../data/LE71880252009104ASN00", {}, {}, {}, {}},
+    {"recent", "../data/LE71880252009264ASN00", {}, {}, {}, {}}
+  };
+  Scene &recent_scene = scenes[2];
+
+  // Scenes are loaded and swept for clouds, water and water type independently of each other.
+  // The common cloud mask is the only join point; it is then cleared from every water mask
+  // without touching the bands again. A scene holds a slot of the governor from loading until
+  // its bands are dropped after classification.
+  TaskGraph graph;
+  std::vector<TaskGraph::Node> classified_scenes;
+  for (auto &scene : scenes) {
+    auto loaded = graph.add([&scene, &governor]() {
+      scene.slot = SceneSlot(governor.scene_slots());
+      scene.image.load_image(scene.directory);
+      scene.image.prefetch({LandsatImage::Band::Blue, LandsatImage::Band::Green,
+                            LandsatImage::Band::NearInfrared});
+      scene.georeference = scene.image.georeference();
+    });
+    classified_scenes.push_back(graph.add([&scene, cores]() {
+      scene.classification = SceneClassifier::classify(cores, scene.image.view_blue_layer(),
+                                                       scene.image.view_green_layer(),
+                                                       scene.image.view_nir_layer());
+      scene.image = LandsatImage();
+      scene.slot.release();
+    }, {loaded}));
+  }
+
+  PixelMask sumarized_cloud_positons;
+  auto clouds_merged = graph.add([&scenes, &sumarized_cloud_positons, cores]() {
+    PixelPositionsLayers localized_clouds;
+    for (auto &scene : scenes) {
+      localized_clouds.emplace(scene.name, std::move(scene.classification.clouds));
+    }
+    sumarized_cloud_positons = merge_pixel_positions_layers(localized_clouds, cores);
+  }, classified_scenes);
+
+  // The scenes share one path and row, so the common mask lies on the grid of any of them.
+  graph.add([&sumarized_cloud_positons, &recent_scene, cores]() {
+    CogWriter::save(sumarized_cloud_positons, "common_clouds.tif", cores,
+                    recent_scene.georeference);
+  }, {clouds_merged});
+
+  TaskGraph::Node recent_water_cleared = 0;
+  for (auto &scene : scenes) {
+    auto water_cleared = graph.add([&scene, &sumarized_cloud_positons]() {
+      auto &water_localization = scene.classification.water;
+      water_localization.subtract(sumarized_cloud_positons);
+      std::cout << "INFO Water Coherer: Localized " + std::to_string(water_localization.count()) +
+                   " pixels of water.\n" << std::flush;
+    }, {clouds_merged});
+
+    graph.add([&scene, cores]() {
+      auto file_name = std::string(scene.name) + "_water.tif";
+      CogWriter::save(scene.classification.water, file_name, cores,
+                      scene.georeference);
+    }, {water_cleared});
+
+    if (&scene == &recent_scene) {
+      recent_water_cleared = water_cleared;
+    }
+  }
+
+  graph.add([&recent_scene, cores]() {
+    WaterDifferencer differencer(recent_scene.classification.water);
+    CogWriter::save(
+      differencer.generate_clasterized_water_layer(recent_scene.classification.bright_water),
+      "different_water_types.tif", cores, recent_scene.georeference);
+  }, {recent_water_cleared});
+
+  graph.run();
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,130 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+// Checks that every vector implementation of RasterKernels available on this processor is
+// GeoReference::pixel_window at the edges of the raster and of double arithmetic: boxes inside,
+// across and outside the raster, coordinates that are not finite and pixel sizes so small that
+// dividing by them overflows. References are read from files written with libtiff.
+
+#include "GeoReference.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  const unsigned int raster_width = 100;
+  const unsigned int raster_height = 80;
+
+  std::string temporary_path(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / ("WaterCoherer_" + name + ".tif")).string();
+  }
+
+  // North-up reference with square pixels and the outer corner of pixel (0, 0) at the origin.
+  GeoReference reference(double pixel_size, double origin_x, double origin_y) {
+    GeoReference::register_tags();
+    auto path = temporary_path("georeference");
+    TIFF *tiff = TIFFOpen(path.c_str(), "w");
+    if (nullptr == tiff) {
+      return GeoReference();
+    }
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, 1);
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, 1);
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 8);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    double scale[3] = {pixel_size, pixel_size, 0.};
+    double tiepoint[6] = {0., 0., 0., origin_x, origin_y, 0.};
+    TIFFSetField(tiff, GeoReference::model_pixel_scale_tag, 3, scale);
+    TIFFSetField(tiff, GeoReference::model_tiepoint_tag, 6, tiepoint);
+    unsigned char pixel = 0;
+    TIFFWriteScanline(tiff, &pixel, 0, 0);
+    TIFFClose(tiff);
+    auto result = GeoReference::read(path);
+    std::remove(path.c_str());
+    return result;
+  }
+
+  bool expect(const GeoReference &georeference, const MapBoundingBox &box,
+              const PixelWindow &expected, const std::string &what) {
+    auto window = georeference.pixel_window(box, raster_width, raster_height);
+    bool same = window.x == expected.x && window.y == expected.y &&
+                window.width == expected.width && window.height == expected.height;
+    if (!same) {
+      std::cerr << what << ": window " << window.x << "," << window.y << " " << window.width <<
+                "x" << window.height << " instead of " << expected.x << "," << expected.y << " " <<
+                expected.width << "x" << expected.height << std::endl;
+    }
+    return same;
+  }
+
+  bool check_pixel_window() {
+    // Pixels of 30 m; the raster spans 1000 to 4000 east and -400 to 2000 north.
+    auto georeference = reference(30., 1000., 2000.);
+    if (!georeference.valid()) {
+      std::cerr << "Reference could not be read" << std::endl;
+      return false;
+    }
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    double infinity = std::numeric_limits<double>::infinity();
+    const PixelWindow empty;
+    bool same = true;
+    same = expect(georeference, {1060., 1400., 1150., 1940.}, {2, 2, 3, 18}, "inside") && same;
+    // Edges inside pixels take in the whole pixels.
+    same = expect(georeference, {1075., 1401., 1136., 1939.}, {2, 2, 3, 18}, "partial pixels") &&
+           same;
+    same = expect(georeference, {970., 1400., 1090., 2030.}, {0, 0, 3, 20}, "across the corner") &&
+           same;
+    same = expect(georeference, {0., -1000., 9000., 3000.}, {0, 0, raster_width, raster_height},
+                  "around the raster") && same;
+    same = expect(georeference, {-1e30, -1e30, 1e30, 1e30}, {0, 0, raster_width, raster_height},
+                  "beyond unsigned int") && same;
+    same = expect(georeference, {4000., 1000., 5000., 1500.}, empty, "east of the raster") && same;
+    same = expect(georeference, {1000., 2000., 1500., 2500.}, empty, "north of the raster") && same;
+    same = expect(georeference, {1150., 1400., 1060., 1940.}, empty, "inverted") && same;
+    same = expect(georeference, {1060., 1400., 1060., 1940.}, empty, "no width") && same;
+    same = expect(georeference, {nan, 1400., 1150., 1940.}, empty, "NaN edge") && same;
+    same = expect(georeference, {1060., nan, 1150., 1940.}, empty, "NaN bottom") && same;
+    same = expect(georeference, {-infinity, 1400., 1150., 1940.}, empty, "infinite edge") &&
+           same;
+    same = expect(georeference, {1060., 1400., 1150., infinity}, empty, "infinite top") && same;
+
+    // Dividing by a subnormal pixel size overflows to infinity.
+    auto tiny = reference(1e-320, 0., 0.);
+    same = expect(tiny, {1., -1., 2., 0.}, empty, "subnormal pixels") && same;
+
+    same = expect(GeoReference(), {1060., 1400., 1150., 1940.}, empty, "no reference") && same;
+    return same;
+  }
+}
+
+int main() {
+  bool window = check_pixel_window();
+  std::cout << "pixel_window: " << (window ? "clipped" : "FAILED") << std::endl;
+  return window ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+// Writes random masks with CogWriter and TiffStripWriter and reads them back with
+// TiffReader::load_mask, at widths that end inside a byte, a word and a tile. Bilevel files
+// from other tools store set pixels as 0 when they are MINISWHITE; those are written here with
+// libtiff directly.
+
+#include "CogWriter.hpp"
+#include "TiffReader.hpp"
+#include "TiffWriter.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  const unsigned int widths[] = {1, 7, 9, 63, 64, 65, 513, 1031, 4097};
+  const unsigned int cores = 4;
+
+  // Deterministic pseudo-random bits, so failures reproduce.
+  uint64_t next_random(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  PixelMask random_mask(unsigned int width, unsigned int height, uint64_t seed) {
+    PixelMask mask(width, height);
+    for (unsigned int y = 0; y < height; ++y) {
+      for (unsigned int x = 0; x < width; ++x) {
+        if (next_random(seed) & 1U) {
+          mask.set(x, y);
+        }
+      }
+    }
+    return mask;
+  }
+
+  // Only pixels are compared; the bits past the row's width are not part of the mask.
+  bool same_pixels(const PixelMask &expected, const PixelMask &actual) {
+    if (expected.width() != actual.width() || expected.height() != actual.height()) {
+      return false;
+    }
+    for (unsigned int y = 0; y < expected.height(); ++y) {
+      for (unsigned int x = 0; x < expected.width(); ++x) {
+        if (expected.test(x, y) != actual.test(x, y)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  std::string temporary_path(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / ("WaterCoherer_" + name + ".tif")).string();
+  }
+
+  bool read_back(const PixelMask &mask, const std::string &path, const std::string &what) {
+    bool same = same_pixels(mask, TiffReader::load_mask(path, cores));
+    std::remove(path.c_str());
+    if (!same) {
+      std::cerr << what << " differs at " << mask.width() << "x" << mask.height() << std::endl;
+    }
+    return same;
+  }
+
+  bool check_cog_writer() {
+    for (unsigned int width : widths) {
+      // Heights below, at and past one tile, so the mask gets overviews.
+      for (unsigned int height : {1u, 3u, CogWriter::tile_size + 3}) {
+        auto mask = random_mask(width, height, width * 31 + height);
+        auto path = temporary_path("cog_" + std::to_string(width) + "x" + std::to_string(height));
+        if (!CogWriter::save(mask, path, cores) || !read_back(mask, path, "CogWriter mask")) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool check_strip_writer() {
+    for (unsigned int width : widths) {
+      for (auto compression : {TiffStripWriter::Compression::Uncompressed,
+                               TiffStripWriter::Compression::Deflate}) {
+        // Enough rows for a few strips and a partial last one, arriving in uneven chunks that
+        // start and end inside strips.
+        unsigned int height = 2 * (TiffStripWriter::strip_bytes / ((width + 7) / 8)) + 5;
+        auto mask = random_mask(width, height, width * 17 + height);
+        auto path = temporary_path("strips_" + std::to_string(width));
+        TiffStripWriter writer(path, width, height, GeoReference(), compression);
+        for (unsigned int row = 0, chunk = 1; row < height; row += chunk, chunk = chunk * 3 + 1) {
+          chunk = std::min(chunk, height - row);
+          PixelMask rows(width, chunk);
+          std::copy(mask.row(row), mask.row(row) + rows.words_per_row() * chunk, rows.row(0));
+          if (!writer.write_rows(rows, cores)) {
+            writer.close();
+            return false;
+          }
+        }
+        if (!writer.close() || !read_back(mask, path, "TiffStripWriter mask")) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Set pixels are stored as 0 bits, the most significant bit first.
+  bool write_min_is_white(const PixelMask &mask, const std::string &path) {
+    TIFF *tiff = TIFFOpen(path.c_str(), "w");
+    if (nullptr == tiff) {
+      return false;
+    }
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, mask.width());
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, mask.height());
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 1);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, 7);
+    TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    std::vector<unsigned char> row((mask.width() + 7) / 8);
+    bool written = true;
+    for (unsigned int y = 0; y < mask.height() && written; ++y) {
+      mask.pack_msb_first(y, 0, mask.width(), row.data());
+      for (auto &byte : row) {
+        byte = static_cast<unsigned char>(~byte);
+      }
+      written = TIFFWriteScanline(tiff, row.data(), y, 0) == 1;
+    }
+    TIFFClose(tiff);
+    return written;
+  }
+
+  bool check_min_is_white() {
+    for (unsigned int width : widths) {
+      auto mask = random_mask(width, 30, width * 7);
+      auto path = temporary_path("white_" + std::to_string(width));
+      if (!write_min_is_white(mask, path) || !read_back(mask, path, "MINISWHITE mask")) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+int main() {
+  bool cog = check_cog_writer();
+  std::cout << "CogWriter: " << (cog ? "read back" : "FAILED") << std::endl;
+  bool strips = check_strip_writer();
+  std::cout << "TiffStripWriter: " << (strips ? "read back" : "FAILED") << std::endl;
+  bool white = check_min_is_white();
+  std::cout << "MINISWHITE: " << (white ? "read back" : "FAILED") << std::endl;
+  return cog && strips && white ? 0 : 1;
+}
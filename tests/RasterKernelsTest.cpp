@@ -0,0 +1,233 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+// Checks that every vector implementation of RasterKernels available on this processor is
+// bit-exact with the scalar path: over all pairs of 8-bit band values, every threshold, and row
+// widths that leave partial words and vector tails.
+
+#include "RasterKernels.hpp"
+#include "TwoBandLookupTable.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace WaterCoherer;
+
+namespace {
+  using Word = RasterKernels::Word;
+  using Bytes = std::vector<unsigned char>;
+  using Words = std::vector<Word>;
+
+  const unsigned int widths[] = {0, 1, 7, 15, 16, 17, 31, 33, 63, 64, 65, 127, 128, 129, 191,
+                                 255, 257, 1000, 4097};
+
+  // Deterministic pseudo-random bytes, so failures reproduce.
+  uint64_t next_random(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  Bytes random_bytes(std::size_t size, uint64_t seed) {
+    Bytes bytes(size);
+    for (auto &byte : bytes) {
+      byte = static_cast<unsigned char>(next_random(seed));
+    }
+    return bytes;
+  }
+
+  Words random_words(std::size_t size, uint64_t seed) {
+    Words words(size);
+    for (auto &word : words) {
+      word = next_random(seed);
+    }
+    return words;
+  }
+
+  // Runs the kernel once with the scalar path and once with the instruction set under test.
+  template<typename Result>
+  bool same_as_scalar(RasterKernels::InstructionSet instruction_set,
+                      const std::function<Result()> &kernel) {
+    RasterKernels::use_instruction_set(RasterKernels::InstructionSet::Scalar);
+    Result expected = kernel();
+    RasterKernels::use_instruction_set(instruction_set);
+    return kernel() == expected;
+  }
+
+  bool check_threshold_above(RasterKernels::InstructionSet instruction_set) {
+    // Every value against every threshold, at every offset of a vector.
+    Bytes values(4097 + 256);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      values[i] = static_cast<unsigned char>(i);
+    }
+    for (unsigned int threshold = 0; threshold < 256; ++threshold) {
+      for (unsigned int width : widths) {
+        bool same = same_as_scalar<Words>(instruction_set, [&values, width, threshold]() {
+          Words words(PixelMask::words_for_width(width) + 1, 0);
+          RasterKernels::threshold_above(values.data() + threshold, width,
+                                         static_cast<unsigned char>(threshold), words.data());
+          return words;
+        });
+        if (!same) {
+          std::cerr << "threshold_above differs at width " << width << ", threshold "
+                    << threshold << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool check_lookup_two_band(RasterKernels::InstructionSet instruction_set) {
+    // One row holds every pair of band values.
+    Bytes first(TwoBandLookupTable::size);
+    Bytes second(TwoBandLookupTable::size);
+    for (unsigned int i = 0; i < TwoBandLookupTable::size; ++i) {
+      first[i] = static_cast<unsigned char>(i >> 8);
+      second[i] = static_cast<unsigned char>(i);
+    }
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    std::vector<TwoBandLookupTable> tables = {
+      TwoBandLookupTable::normalized_difference(0.33f, true),
+      TwoBandLookupTable::normalized_difference(1.f, false),
+      TwoBandLookupTable::build([&seed](unsigned char, unsigned char) {
+        return next_random(seed) % 2 == 0;
+      })
+    };
+    for (const auto &table : tables) {
+      bool same = same_as_scalar<Words>(instruction_set, [&table, &first, &second]() {
+        Words words(PixelMask::words_for_width(TwoBandLookupTable::size));
+        table.classify_row(first.data(), second.data(), TwoBandLookupTable::size, words.data());
+        return words;
+      });
+      for (unsigned int width : widths) {
+        same = same && same_as_scalar<Words>(instruction_set, [&table, &first, &second,
+                                                               width]() {
+          Words words(PixelMask::words_for_width(width) + 1, 0);
+          table.classify_row(first.data() + 40000, second.data() + 40000, width, words.data());
+          return words;
+        });
+      }
+      if (!same) {
+        std::cerr << "lookup_two_band differs from the scalar path" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_unite_and_subtract(RasterKernels::InstructionSet instruction_set) {
+    for (std::size_t size = 0; size < 40; ++size) {
+      auto words = random_words(size, size + 1);
+      auto other = random_words(size, size + 100);
+      bool same = same_as_scalar<Words>(instruction_set, [&words, &other, size]() {
+        auto result = words;
+        RasterKernels::unite(result.data(), other.data(), size);
+        return result;
+      }) && same_as_scalar<Words>(instruction_set, [&words, &other, size]() {
+        auto result = words;
+        RasterKernels::subtract(result.data(), other.data(), size);
+        return result;
+      });
+      if (!same) {
+        std::cerr << "unite or subtract differs at " << size << " words" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_expand(RasterKernels::InstructionSet instruction_set) {
+    for (unsigned int width : widths) {
+      auto words = random_words(PixelMask::words_for_width(width) + 1, width + 7);
+      bool same = same_as_scalar<Bytes>(instruction_set, [&words, width]() {
+        Bytes pixels(width + 1, 7);
+        RasterKernels::expand(words.data(), width, pixels.data());
+        return pixels;
+      });
+      if (!same) {
+        std::cerr << "expand differs at width " << width << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool check_split_water_types(RasterKernels::InstructionSet instruction_set) {
+    for (unsigned int width : widths) {
+      auto water = random_words(PixelMask::words_for_width(width) + 1, width + 11);
+      auto nir = random_bytes(width, width + 13);
+      for (unsigned int threshold : {0u, 1u, 50u, 127u, 128u, 200u, 254u, 255u}) {
+        bool same = same_as_scalar<Bytes>(instruction_set, [&water, &nir, width, threshold]() {
+          Bytes pixels(2 * (width + 1), 7);
+          RasterKernels::split_water_types(water.data(), nir.data(), width,
+                                           static_cast<unsigned char>(threshold), pixels.data(),
+                                           pixels.data() + width + 1);
+          return pixels;
+        });
+        if (!same) {
+          std::cerr << "split_water_types differs at width " << width << ", threshold "
+                    << threshold << std::endl;
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  const char *name(RasterKernels::InstructionSet instruction_set) {
+    switch (instruction_set) {
+      case RasterKernels::InstructionSet::SSE2:
+        return "SSE2";
+      case RasterKernels::InstructionSet::AVX2:
+        return "AVX2";
+      case RasterKernels::InstructionSet::AVX512:
+        return "AVX-512";
+      default:
+        return "scalar";
+    }
+  }
+}
+
+int main() {
+  bool passed = true;
+  for (auto instruction_set : {RasterKernels::InstructionSet::SSE2,
+                               RasterKernels::InstructionSet::AVX2,
+                               RasterKernels::InstructionSet::AVX512}) {
+    if (!RasterKernels::use_instruction_set(instruction_set)) {
+      std::cout << name(instruction_set) << ": not supported, skipped" << std::endl;
+      continue;
+    }
+    bool same = check_threshold_above(instruction_set) &&
+                check_lookup_two_band(instruction_set) &&
+                check_unite_and_subtract(instruction_set) && check_expand(instruction_set) &&
+                check_split_water_types(instruction_set);
+    std::cout << name(instruction_set) << ": " << (same ? "bit-exact" : "DIFFERS") << std::endl;
+    passed = passed && same;
+  }
+  return passed ? 0 : 1;
+}
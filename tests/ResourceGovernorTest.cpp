@@ -0,0 +1,90 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+// Checks that every vector implementation of RasterKernels available on this processor is
+// Parsing of the cgroup v2 files ResourceGovernor takes the processor and memory budget from:
+// cpu.max and memory.max as the kernel writes them, without a limit, and contents of any other
+// form, which make it fall back to the cgroup v1 files.
+
+#include "ResourceGovernor.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+using namespace WaterCoherer;
+
+namespace {
+  bool expect_cpu_max(const std::string &contents, bool parsed, double processors) {
+    double result = -1.;
+    bool same = ResourceGovernor::parse_cpu_max(contents, result) == parsed &&
+                (!parsed || result == processors);
+    if (!same) {
+      std::cerr << "cpu.max \"" << contents << "\" gave " << result << std::endl;
+    }
+    return same;
+  }
+
+  bool expect_memory_max(const std::string &contents, bool parsed, std::size_t bytes) {
+    std::size_t result = 1;
+    bool same = ResourceGovernor::parse_memory_max(contents, result) == parsed &&
+                (!parsed || result == bytes);
+    if (!same) {
+      std::cerr << "memory.max \"" << contents << "\" gave " << result << std::endl;
+    }
+    return same;
+  }
+
+  bool check_cpu_max() {
+    bool same = true;
+    same = expect_cpu_max("400000 100000", true, 4.) && same;
+    same = expect_cpu_max("150000 100000\n", true, 1.5) && same;
+    same = expect_cpu_max("50000 100000", true, .5) && same;
+    same = expect_cpu_max("max 100000", true, 0.) && same;
+    same = expect_cpu_max("400000 0", true, 0.) && same;
+    same = expect_cpu_max("", false, 0.) && same;
+    same = expect_cpu_max("400000", false, 0.) && same;
+    same = expect_cpu_max("quota 100000", false, 0.) && same;
+    same = expect_cpu_max("400000 period", false, 0.) && same;
+    return same;
+  }
+
+  bool check_memory_max() {
+    bool same = true;
+    same = expect_memory_max("4294967296", true, std::size_t{4} << 30) && same;
+    same = expect_memory_max("536870912\n", true, std::size_t{512} << 20) && same;
+    same = expect_memory_max("max", true, 0) && same;
+    same = expect_memory_max("", false, 0) && same;
+    same = expect_memory_max("-1", false, 0) && same;
+    same = expect_memory_max("12G", false, 0) && same;
+    return same;
+  }
+}
+
+int main() {
+  bool cpu = check_cpu_max();
+  std::cout << "cpu.max: " << (cpu ? "parsed" : "FAILED") << std::endl;
+  bool memory = check_memory_max();
+  std::cout << "memory.max: " << (memory ? "parsed" : "FAILED") << std::endl;
+  return cpu && memory ? 0 : 1;
+}
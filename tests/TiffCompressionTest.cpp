@@ -0,0 +1,118 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2019 Rafal Aleksander
+
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+
+// Checks that every vector implementation of RasterKernels available on this processor is
+// Strips encoded by TiffCompression::lzw are decoded by libtiff and compared with their input:
+// short ones, runs long enough to widen codes to 12 bits and random bytes that fill the table
+// several times, so it is cleared in the middle of a strip.
+
+#include "TiffCompression.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <tiffio.h>
+
+using namespace WaterCoherer;
+
+namespace {
+  // Deterministic pseudo-random bytes, so failures reproduce.
+  uint64_t next_random(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  std::string temporary_path(const std::string &name) {
+    return (std::filesystem::temp_directory_path() / ("WaterCoherer_" + name + ".tif")).string();
+  }
+
+  // The bytes go into one row of an 8-bit band, stored as a single raw strip.
+  bool decoded_by_libtiff(const std::vector<unsigned char> &data, const std::string &name) {
+    std::vector<unsigned char> encoded;
+    TiffCompression::lzw(data.data(), data.size(), encoded);
+    auto path = temporary_path("lzw_" + name);
+    TIFF *tiff = TIFFOpen(path.c_str(), "w");
+    if (nullptr == tiff) {
+      return false;
+    }
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, static_cast<uint32_t>(data.size()));
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, 1);
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 8);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, 1);
+    TIFFSetField(tiff, TIFFTAG_COMPRESSION, TiffCompression::lzw_tag);
+    auto size = static_cast<tmsize_t>(encoded.size());
+    bool written = TIFFWriteRawStrip(tiff, 0, encoded.data(), size) == size;
+    TIFFClose(tiff);
+
+    std::vector<unsigned char> decoded(data.size());
+    bool same = false;
+    tiff = written ? TIFFOpen(path.c_str(), "r") : nullptr;
+    if (nullptr != tiff) {
+      auto decoded_size = static_cast<tmsize_t>(decoded.size());
+      same = TIFFReadEncodedStrip(tiff, 0, decoded.data(), decoded_size) == decoded_size &&
+             decoded == data;
+      TIFFClose(tiff);
+    }
+    std::remove(path.c_str());
+    if (!same) {
+      std::cerr << "LZW strip " << name << " of " << data.size() << " bytes differs" << std::endl;
+    }
+    return same;
+  }
+
+  bool check_lzw() {
+    bool same = true;
+    for (std::size_t size : {1, 2, 3, 255, 256, 257, 4093, 4094, 4095, 70000}) {
+      std::vector<unsigned char> constant(size, 7);
+      std::vector<unsigned char> ramp(size);
+      std::vector<unsigned char> noise(size);
+      std::vector<unsigned char> four_values(size);
+      uint64_t state = size * 2654435761U + 1;
+      for (std::size_t i = 0; i < size; ++i) {
+        ramp[i] = static_cast<unsigned char>(i / 3);
+        noise[i] = static_cast<unsigned char>(next_random(state));
+        four_values[i] = static_cast<unsigned char>(next_random(state) & 3U);
+      }
+      auto suffix = "_" + std::to_string(size);
+      same = decoded_by_libtiff(constant, "constant" + suffix) &&
+             decoded_by_libtiff(ramp, "ramp" + suffix) &&
+             decoded_by_libtiff(noise, "noise" + suffix) &&
+             decoded_by_libtiff(four_values, "four_values" + suffix) && same;
+    }
+    return same;
+  }
+}
+
+int main() {
+  bool lzw = check_lzw();
+  std::cout << "LZW: " << (lzw ? "decoded by libtiff" : "FAILED") << std::endl;
+  return lzw ? 0 : 1;
+}